@@ -0,0 +1,86 @@
+#include <fstream>
+#include "BalanceReport.h"
+#include "DbWrapper.h"
+#include "DbWrapperException.h"
+#include "Utxo.h"
+#include "utils.h"
+
+namespace {
+// Counters kept per partition for each requested top entry. More counters
+// tighten the error bound of every reported balance.
+const size_t g_countersPerEntry = 4;
+const size_t g_minCounters = 1024;
+}
+
+BalanceReport::BalanceReport(size_t topK, bool quantiles, size_t partitions)
+	: m_topK(topK), m_quantiles(quantiles)
+{
+	// forEachUTXO splits the keyspace by the first txid byte
+	partitions = partitions == 0 ? 1 : partitions > 256 ? 256 : partitions;
+	if (m_quantiles) {
+		m_sketches.resize(partitions);
+	}
+	if (m_topK) {
+		size_t capacity = m_topK * g_countersPerEntry;
+		m_heavyHitters.assign(partitions, HeavyHitters(capacity < g_minCounters ? g_minCounters : capacity));
+	}
+}
+
+void BalanceReport::run(DBWrapper& db)
+{
+	size_t partitions = m_quantiles ? m_sketches.size() : m_heavyHitters.size();
+	db.forEachUTXO(partitions, [this](size_t partition, const BytesVec&, uint32_t, const UTXO& utxo) {
+		if (m_quantiles) {
+			m_sketches[partition].add(utxo.getAmount());
+		}
+		if (m_topK && utxo.getAmount()) {
+			const auto& script = utxo.getPublicKey();
+			m_heavyHitters[partition].add(std::string(script.begin(), script.end()), utxo.getAmount());
+		}
+	});
+
+	for (size_t i = 1; i < m_sketches.size(); i++) {
+		m_sketches[0].merge(m_sketches[i]);
+	}
+	for (size_t i = 1; i < m_heavyHitters.size(); i++) {
+		m_heavyHitters[0].merge(m_heavyHitters[i]);
+	}
+}
+
+/**
+ * Quantiles are written as "quantile,value" rows. Top scripts are written as
+ * "rank,script,balance,max_overcount" rows: the true balance lies between
+ * balance - max_overcount and balance.
+ * */
+void BalanceReport::write(const std::filesystem::path& path) const
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::string errMsg("Can't create the output file ");
+		errMsg += path.string();
+		throw DbWrapperException(errMsg.c_str());
+	}
+
+	if (m_quantiles) {
+		const auto& sketch = m_sketches[0];
+		static const double quantiles[] = {0, 0.01, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 1};
+		file << "# UTXO value quantiles in satoshis over " << sketch.count() << " coins\n";
+		file << "quantile,value\n";
+		for (auto q : quantiles) {
+			file << q << "," << sketch.quantile(q) << "\n";
+		}
+	}
+
+	if (m_topK) {
+		const auto& heavyHitters = m_heavyHitters[0];
+		file << "# Top " << m_topK << " scripts by balance in satoshis\n";
+		file << "rank,script,balance,max_overcount\n";
+		size_t rank = 1;
+		for (const auto& entry : heavyHitters.top(m_topK)) {
+			BytesVec script(entry.key.begin(), entry.key.end());
+			std::string scriptStr;
+			utils::bytesToHexstring(script, scriptStr);
+			file << rank++ << "," << scriptStr << "," << entry.weight << "," << entry.error << "\n";
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <filesystem>
+#include "QuantileSketch.h"
+#include "HeavyHitters.h"
+
+class DBWrapper;
+
+/**
+ * Answers "top K scripts by balance" and "UTXO value quantiles" in one
+ * parallel scan with bounded memory, instead of exporting and sorting.
+ *
+ * Every scan partition feeds its own QuantileSketch and HeavyHitters. They
+ * are merged once the scan is done, so memory stays at a few MB per thread
+ * regardless of the size of the UTXO set.
+ * */
+class BalanceReport {
+public:
+	BalanceReport(size_t topK, bool quantiles, size_t partitions);
+	void run(DBWrapper& db);
+	void write(const std::filesystem::path& path) const;
+
+private:
+	size_t m_topK;
+	bool m_quantiles;
+	std::vector<QuantileSketch> m_sketches;
+	std::vector<HeavyHitters> m_heavyHitters;
+};
@@ -0,0 +1,19 @@
+#include "CsvWriter.h"
+#include "Utxo.h"
+#include "utils.h"
+
+CsvWriter::CsvWriter(const std::filesystem::path& path)
+	: FileRecordWriter(path)
+{
+}
+
+void CsvWriter::write(const UTXO& utxo)
+{
+	std::string scriptPubKeyStr;
+	utils::bytesToHexstring(utxo.getPublicKey(), scriptPubKeyStr);
+	m_buffer += scriptPubKeyStr;
+	m_buffer += ",";
+	m_buffer += std::to_string(utxo.getAmount());
+	m_buffer += "\n";
+	flushIfFull();
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "RecordWriter.h"
+
+/**
+ * The original export format: "scriptPubKeyHex,amount" per line.
+ * */
+class CsvWriter : public FileRecordWriter {
+public:
+	explicit CsvWriter(const std::filesystem::path& path);
+	void write(const UTXO& utxo) override;
+};
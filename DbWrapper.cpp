@@ -2,16 +2,28 @@
 #include <stdexcept>
 #include <memory>
 #include <fstream>
+#include <thread>
+#include <exception>
 
 #include "DbWrapper.h"
 #include "utils.h"
 #include "Utxo.h"
 #include "DbWrapperException.h"
+#include "ShardedWriter.h"
+#include "UtxoCommitment.h"
+#include "Prefetcher.h"
 
-DBWrapper::DBWrapper(const std::filesystem::path& dbName) 
-	: m_dbName(dbName)
+DBWrapper::DBWrapper(const std::filesystem::path& dbName, const ScanProfile& profile) 
+	: m_profile(profile), m_dbName(dbName)
 {
 	m_options = leveldb::Options();
+	if (m_profile.blockCacheSize) {
+		m_blockCache.reset(leveldb::NewLRUCache(m_profile.blockCacheSize));
+		m_options.block_cache = m_blockCache.get();
+	}
+	if (m_profile.maxOpenFiles) {
+		m_options.max_open_files = m_profile.maxOpenFiles;
+	}
 	openDB();
 	setObfuscationKey();
 }
@@ -48,45 +60,208 @@ void DBWrapper::openDB()
 	if (!status.ok()) {
 		throw DbWrapperException("Can't open the specified database.");
 	}
-	m_readOptions.verify_checksums = true;
+	m_readOptions.verify_checksums = m_profile.verifyChecksums;
+	m_readOptions.fill_cache = m_profile.fillCache;
 }
 
 void DBWrapper::read(const std::string& key, std::string& val)
 {
 	leveldb::Status status = m_db->Get(m_readOptions, key, &val);
-	if (!m_status.ok()) {
-		std::string errMsg("Error reading obfuscation key");
+	if (!status.ok()) {
+		std::string errMsg("Error reading key");
 		errMsg += ". ";
-		errMsg += m_status.ToString();
+		errMsg += status.ToString();
 		throw DbWrapperException(errMsg.c_str());
 	}
 }
 
-void DBWrapper::dumpAllUTXOs(const std::filesystem::path& path) {
+/**
+ * Decode the coin stored under a 'C' key: the txid, in internal byte order,
+ * and the output index from the key, the UTXO from the obfuscated value.
+ * */
+UTXO DBWrapper::decodeCoin(const leveldb::Slice& key, const leveldb::Slice& value, BytesVec& txid, uint32_t& vout)
+{
+	const size_t keySize = 33;
+	if (key.size() <= keySize) {
+		throw DbWrapperException("Malformed coin key");
+	}
+	const char* keyData = key.data();
+	txid.assign(keyData + 1, keyData + keySize);
+	// The output index follows the txid in the key as a Varint
+	Varint<BytesVec> voutVarint(BytesVec(keyData + keySize, keyData + key.size()));
+	BytesVec voutBytes;
+	voutVarint.decode(0, voutBytes);
+	vout = static_cast<uint32_t>(utils::toUint64(voutBytes));
+
+	BytesVec deObfuscatedValue;
+	deObfuscatedValue.reserve(value.size());
+	deObfuscate(value, deObfuscatedValue);
+	Varint v(deObfuscatedValue);
+	return UTXO(v);
+}
+
+/**
+ * The hash of the block the chainstate is at, stored under the 'B' key.
+ * */
+void DBWrapper::getBestBlockHash(std::string& hash)
+{
+	std::string value;
+	read(std::string(1, 'B'), value);
+	BytesVec bestBlock;
+	deObfuscate(value, bestBlock);
+	utils::switchEndianness(bestBlock);
+	utils::bytesToHexstring(bestBlock, hash);
+}
+
+void DBWrapper::dumpAllUTXOs(const std::filesystem::path& path, const DumpOptions& options,
+	UtxoCommitment* commitment) {
 	std::unique_ptr<leveldb::Iterator> it(m_db->NewIterator(m_readOptions));
-	std::ofstream file(path);
+	ShardedWriter writer(path, options.shards, options.format);
+	std::unique_ptr<Prefetcher> prefetcher;
+	std::string sstables;
+	if (m_profile.prefetchWindow && m_db->GetProperty("leveldb.sstables", &sstables)) {
+		prefetcher = std::make_unique<Prefetcher>(m_dbName, sstables, m_profile.prefetchWindow);
+	}
+	size_t keysSinceAdvance = 0;
 	for (it->SeekToFirst(); it->Valid(); it->Next()) {
-		const size_t keySize = 33;
 		auto key = it->key();
-		const char* keyData = key.data();
-		if (keyData[0] == 'C') { // from the https://en.bitcoin.it/wiki/Bitcoin_Core_0.11_(ch_2):_Data_Storage
-			
-			BytesVec deObfuscatedValue;
-			deObfuscatedValue.reserve(it->value().size());
-			deObfuscate(it->value(), deObfuscatedValue);
-			Varint v(deObfuscatedValue);
+		if (prefetcher && ++keysSinceAdvance == 4096) {
+			prefetcher->advance(key.ToString());
+			keysSinceAdvance = 0;
+		}
+		if (key[0] == 'C') { // from the https://en.bitcoin.it/wiki/Bitcoin_Core_0.11_(ch_2):_Data_Storage
 			BytesVec txid;
-			assert(key.size() > keySize);
-			txid.insert(txid.begin(), keyData + 1, keyData + keySize);
+			uint32_t vout;
+			UTXO u = decodeCoin(key, it->value(), txid, vout);
+			if (commitment) {
+				commitment->add(txid, vout, u);
+			}
 			utils::switchEndianness(txid);
-			UTXO u(v);
 			if (u.getAmount()) {
 				u.setTXID(txid);
-				const auto& pubKey = u.getPublicKey();
-				std::string scriptPubKeyStr;
-				utils::bytesToHexstring(pubKey, scriptPubKeyStr);
-				file << scriptPubKeyStr << "," << u.getAmount() << std::endl;
+				writer.write(options.shardKey == ShardKey::Txid ? txid : u.getPublicKey(), u);
+			}
+		}
+	}
+	if (!it->status().ok()) {
+		throw DbWrapperException("Can't parse all UTXOS");
+	}
+	writer.close();
+	if (commitment) {
+		commitment->finish();
+	}
+}
+
+/**
+ * Visit every coin, splitting the 'C' keyspace into `partitions` ranges of
+ * the first txid byte, each scanned by its own thread and iterator. The
+ * visitor is called concurrently from different partitions, but never
+ * concurrently for the same partition, so it can keep per-partition state.
+ * */
+void DBWrapper::forEachUTXO(size_t partitions, const UTXOVisitor& visitor)
+{
+	if (partitions == 0 || partitions > 256) {
+		throw std::invalid_argument{"The number of partitions must be between 1 and 256"};
+	}
+
+	std::vector<std::thread> threads;
+	std::vector<std::exception_ptr> errors(partitions);
+	for (size_t p = 0; p < partitions; p++) {
+		threads.emplace_back([this, p, partitions, &visitor, &errors] {
+			try {
+				std::string start{'C', static_cast<char>(p * 256 / partitions)};
+				// The last partition runs up to 'D', the first key past the coins
+				std::string end = p + 1 == partitions ? std::string(1, 'D')
+					: std::string{'C', static_cast<char>((p + 1) * 256 / partitions)};
+				std::unique_ptr<leveldb::Iterator> it(m_db->NewIterator(m_readOptions));
+				BytesVec txid;
+				uint32_t vout;
+				for (it->Seek(start); it->Valid() && it->key().compare(end) < 0; it->Next()) {
+					UTXO u = decodeCoin(it->key(), it->value(), txid, vout);
+					utils::switchEndianness(txid);
+					visitor(p, txid, vout, u);
+				}
+				if (!it->status().ok()) {
+					throw DbWrapperException("Can't parse all UTXOS");
+				}
+			} catch (...) {
+				errors[p] = std::current_exception();
 			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	for (auto& e : errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
+}
+
+/**
+ * Point lookup of a single coin; txid is in display byte order.
+ * Returns nullptr if the coin is not in the set.
+ * */
+std::unique_ptr<UTXO> DBWrapper::findUTXO(const std::vector<unsigned char>& txid, uint32_t vout)
+{
+	std::string key(1, 'C');
+	key.append(txid.rbegin(), txid.rend());
+	utils::appendVarint(vout, key);
+
+	std::string value;
+	leveldb::Status status = m_db->Get(m_readOptions, key, &value);
+	if (status.IsNotFound()) {
+		return nullptr;
+	}
+	if (!status.ok()) {
+		std::string errMsg("Error reading key");
+		errMsg += ". ";
+		errMsg += status.ToString();
+		throw DbWrapperException(errMsg.c_str());
+	}
+
+	BytesVec internalTxid;
+	uint32_t keyVout;
+	auto utxo = std::make_unique<UTXO>(decodeCoin(key, value, internalTxid, keyVout));
+	utxo->setTXID(txid);
+	return utxo;
+}
+
+/**
+ * The approximate on-disk size of each [start, end) key range, from the
+ * table file index alone. Keys still in the memtable are not counted.
+ * */
+void DBWrapper::approximateSizes(const std::vector<std::pair<std::string, std::string>>& ranges,
+	std::vector<uint64_t>& sizes)
+{
+	std::vector<leveldb::Range> leveldbRanges;
+	leveldbRanges.reserve(ranges.size());
+	for (const auto& range : ranges) {
+		leveldbRanges.emplace_back(range.first, range.second);
+	}
+	sizes.assign(ranges.size(), 0);
+	if (!ranges.empty()) {
+		m_db->GetApproximateSizes(leveldbRanges.data(), static_cast<int>(leveldbRanges.size()), sizes.data());
+	}
+}
+
+/**
+ * Visit the coins with keys in [start, end) in key order, until the visitor
+ * returns false. Meant for short scans, the iterator is created per call.
+ * */
+void DBWrapper::scanUTXOs(const std::string& start, const std::string& end, const KeyedUTXOVisitor& visitor)
+{
+	std::unique_ptr<leveldb::Iterator> it(m_db->NewIterator(m_readOptions));
+	BytesVec txid;
+	uint32_t vout;
+	for (it->Seek(start); it->Valid() && it->key().compare(end) < 0; it->Next()) {
+		if (it->key()[0] != 'C') {
+			continue;
+		}
+		UTXO u = decodeCoin(it->key(), it->value(), txid, vout);
+		if (!visitor(it->key(), u)) {
+			break;
 		}
 	}
 	if (!it->status().ok()) {
@@ -2,21 +2,75 @@
 
 #include <vector>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include "leveldb/db.h"
+#include "leveldb/cache.h"
 #include "varint.h"
+#include "RecordWriter.h"
+
+class UtxoCommitment;
+class UTXO;
 
 using BytesVec = std::vector<unsigned char>;
 
+/** Which field of a coin decides the output shard it is written to. */
+enum class ShardKey {
+	ScriptPubKey,
+	Txid,
+};
+
+/** How dumpAllUTXOs lays out the exported coins. */
+struct DumpOptions {
+	size_t shards = 1;
+	ShardKey shardKey = ShardKey::ScriptPubKey;
+	OutputFormat format = OutputFormat::Csv;
+};
+
+/**
+ * How LevelDB is opened and read. The defaults are LevelDB's own, which suit
+ * repeated point lookups. coldScan() is tuned for a single full pass over a
+ * chainstate that is not in the page cache.
+ * */
+struct ScanProfile {
+	bool fillCache = true;
+	bool verifyChecksums = true;
+	size_t blockCacheSize = 0;     // bytes, 0 keeps LevelDB's 8 MiB default
+	int maxOpenFiles = 0;          // 0 keeps LevelDB's default of 1000
+	uint64_t prefetchWindow = 0;   // bytes of upcoming table files to read ahead, 0 disables
+
+	static ScanProfile coldScan()
+	{
+		ScanProfile profile;
+		// Blocks of a one-shot scan are never read twice, caching them only evicts index blocks
+		profile.fillCache = false;
+		profile.prefetchWindow = 256 << 20;
+		return profile;
+	}
+};
+
 class DBWrapper {
 public:
-	DBWrapper(const std::filesystem::path& dbName);
+	/** Called for every coin; txid is in display byte order. */
+	using UTXOVisitor = std::function<void(size_t partition, const std::vector<unsigned char>& txid, uint32_t vout, const UTXO& utxo)>;
+	/** Called for every coin of a range scan with its raw key; returning false ends the scan. */
+	using KeyedUTXOVisitor = std::function<bool(const leveldb::Slice& key, const UTXO& utxo)>;
+
+	DBWrapper(const std::filesystem::path& dbName, const ScanProfile& profile = ScanProfile());
 	~DBWrapper();
 	void read(const std::string& key, std::string& val);
-	void dumpAllUTXOs(const std::filesystem::path& path);
+	void dumpAllUTXOs(const std::filesystem::path& path, const DumpOptions& options = DumpOptions(),
+		UtxoCommitment* commitment = nullptr);
+	void getBestBlockHash(std::string& hash);
+	void forEachUTXO(size_t partitions, const UTXOVisitor& visitor);
+	std::unique_ptr<UTXO> findUTXO(const std::vector<unsigned char>& txid, uint32_t vout);
+	void approximateSizes(const std::vector<std::pair<std::string, std::string>>& ranges, std::vector<uint64_t>& sizes);
+	void scanUTXOs(const std::string& start, const std::string& end, const KeyedUTXOVisitor& visitor);
 
 private:
 	void setObfuscationKey();
 	void openDB();
+	UTXO decodeCoin(const leveldb::Slice& key, const leveldb::Slice& value, BytesVec& txid, uint32_t& vout);
 	template <typename T> 
 	void deObfuscate(T bytes, BytesVec& plaintext);
 
@@ -25,6 +79,8 @@ private:
 	std::string m_obfuscationKeyKey;
 	BytesVec m_obfuscationKey;
 	leveldb::Options m_options;
+	ScanProfile m_profile;
+	std::unique_ptr<leveldb::Cache> m_blockCache;
 	std::filesystem::path m_dbName;
 	leveldb::ReadOptions m_readOptions;
 	leveldb::DB* m_db;
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include "HeavyHitters.h"
+
+HeavyHitters::HeavyHitters(size_t capacity)
+	: m_capacity(capacity < 1 ? 1 : capacity)
+{
+	m_counters.reserve(m_capacity);
+}
+
+/** The weight any key not being tracked may have, at most. */
+uint64_t HeavyHitters::minWeight() const
+{
+	return m_counters.size() < m_capacity || m_byWeight.empty() ? 0 : m_byWeight.begin()->first;
+}
+
+void HeavyHitters::setWeight(Counter& counter, uint64_t weight)
+{
+	auto node = m_byWeight.extract(counter.byWeight);
+	node.key() = weight;
+	counter.byWeight = m_byWeight.insert(std::move(node));
+}
+
+void HeavyHitters::add(const std::string& key, uint64_t weight)
+{
+	m_totalWeight += weight;
+	auto it = m_counters.find(key);
+	if (it != m_counters.end()) {
+		setWeight(it->second, it->second.byWeight->first + weight);
+		return;
+	}
+
+	if (m_counters.size() < m_capacity) {
+		Counter counter{m_byWeight.emplace(weight, key), 0};
+		m_counters.emplace(key, counter);
+		return;
+	}
+
+	// Take over the smallest counter
+	auto smallest = m_byWeight.begin();
+	uint64_t inherited = smallest->first;
+	m_counters.erase(smallest->second);
+	m_byWeight.erase(smallest);
+	Counter counter{m_byWeight.emplace(inherited + weight, key), inherited};
+	m_counters.emplace(key, counter);
+}
+
+void HeavyHitters::merge(const HeavyHitters& other)
+{
+	const uint64_t ownMin = minWeight();
+	const uint64_t otherMin = other.minWeight();
+
+	// Keys missing from one summary may have had up to its minimum weight there.
+	std::vector<Entry> merged;
+	merged.reserve(m_counters.size() + other.m_counters.size());
+	for (const auto& c : m_counters) {
+		auto o = other.m_counters.find(c.first);
+		if (o != other.m_counters.end()) {
+			merged.push_back({c.first, c.second.byWeight->first + o->second.byWeight->first,
+				c.second.error + o->second.error});
+		} else {
+			merged.push_back({c.first, c.second.byWeight->first + otherMin, c.second.error + otherMin});
+		}
+	}
+	for (const auto& o : other.m_counters) {
+		if (m_counters.find(o.first) == m_counters.end()) {
+			merged.push_back({o.first, o.second.byWeight->first + ownMin, o.second.error + ownMin});
+		}
+	}
+
+	if (merged.size() > m_capacity) {
+		std::nth_element(merged.begin(), merged.begin() + m_capacity, merged.end(),
+			[](const Entry& a, const Entry& b) { return a.weight > b.weight; });
+		merged.resize(m_capacity);
+	}
+
+	m_counters.clear();
+	m_byWeight.clear();
+	for (auto& e : merged) {
+		Counter counter{m_byWeight.emplace(e.weight, e.key), e.error};
+		m_counters.emplace(std::move(e.key), counter);
+	}
+	m_totalWeight += other.m_totalWeight;
+}
+
+/** The k keys with the largest estimated weight, largest first. */
+std::vector<HeavyHitters::Entry> HeavyHitters::top(size_t k) const
+{
+	std::vector<Entry> result;
+	for (auto it = m_byWeight.rbegin(); it != m_byWeight.rend() && result.size() < k; ++it) {
+		result.push_back({it->second, it->first, m_counters.at(it->second).error});
+	}
+	return result;
+}
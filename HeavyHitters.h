@@ -0,0 +1,49 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * Weighted Space-Saving summary: tracks the keys with the largest total
+ * weight using a fixed number of counters.
+ *
+ * When a new key arrives and every counter is taken, the smallest counter is
+ * handed over to it and keeps its old total, which is recorded as that key's
+ * error. A key's estimate never undercounts, and overcounts by at most its
+ * error, which is bounded by totalWeight / capacity. Summaries built on
+ * separate threads merge with the same bound.
+ * See: Agarwal et al., "Mergeable Summaries" (2012)
+ * */
+class HeavyHitters {
+public:
+	struct Entry {
+		std::string key;
+		uint64_t weight;
+		uint64_t error;
+	};
+
+	explicit HeavyHitters(size_t capacity);
+	void add(const std::string& key, uint64_t weight);
+	void merge(const HeavyHitters& other);
+	std::vector<Entry> top(size_t k) const;
+	uint64_t totalWeight() const {
+		return m_totalWeight;
+	}
+
+private:
+	struct Counter {
+		std::multimap<uint64_t, std::string>::iterator byWeight;
+		uint64_t error;
+	};
+	uint64_t minWeight() const;
+	void setWeight(Counter& counter, uint64_t weight);
+
+private:
+	size_t m_capacity;
+	uint64_t m_totalWeight = 0;
+	std::unordered_map<std::string, Counter> m_counters;
+	std::multimap<uint64_t, std::string> m_byWeight;
+};
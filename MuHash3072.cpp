@@ -0,0 +1,173 @@
+#include <cstring>
+#include "MuHash3072.h"
+#include "Sha256.h"
+
+namespace {
+// 2^3072 - p
+const uint32_t g_maxPrimeDiff = 1103717;
+
+inline uint32_t rotl(uint32_t v, int c)
+{
+	return (v << c) | (v >> (32 - c));
+}
+
+inline uint32_t readLE32(const unsigned char* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void writeLE32(unsigned char* p, uint32_t v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+/** ChaCha20 keystream with a zero nonce, starting at block 0. */
+void chacha20Keystream(const unsigned char key[32], unsigned char* out, size_t len)
+{
+	uint32_t input[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+	for (int i = 0; i < 8; i++) {
+		input[4 + i] = readLE32(key + 4 * i);
+	}
+
+	for (uint32_t block = 0; len > 0; block++) {
+		input[12] = block;
+		uint32_t x[16];
+		memcpy(x, input, sizeof(x));
+		for (int i = 0; i < 10; i++) {
+#define QUARTERROUND(a, b, c, d) \
+			x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16); \
+			x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12); \
+			x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8); \
+			x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+			QUARTERROUND(0, 4, 8, 12)
+			QUARTERROUND(1, 5, 9, 13)
+			QUARTERROUND(2, 6, 10, 14)
+			QUARTERROUND(3, 7, 11, 15)
+			QUARTERROUND(0, 5, 10, 15)
+			QUARTERROUND(1, 6, 11, 12)
+			QUARTERROUND(2, 7, 8, 13)
+			QUARTERROUND(3, 4, 9, 14)
+#undef QUARTERROUND
+		}
+		unsigned char keystream[64];
+		for (int i = 0; i < 16; i++) {
+			writeLE32(keystream + 4 * i, x[i] + input[i]);
+		}
+		size_t take = len < 64 ? len : 64;
+		memcpy(out, keystream, take);
+		out += take;
+		len -= take;
+	}
+}
+}
+
+Num3072::Num3072()
+{
+	m_limbs[0] = 1;
+	for (size_t i = 1; i < LIMBS; i++) {
+		m_limbs[i] = 0;
+	}
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+	for (size_t i = 0; i < LIMBS; i++) {
+		m_limbs[i] = readLE32(data + 4 * i);
+	}
+}
+
+/** True if the number is at least p, i.e. adding 2^3072 - p overflows 3072 bits. */
+bool Num3072::isOverflow() const
+{
+	if (m_limbs[0] <= UINT32_MAX - g_maxPrimeDiff) {
+		return false;
+	}
+	for (size_t i = 1; i < LIMBS; i++) {
+		if (m_limbs[i] != UINT32_MAX) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Subtract p once, which is the same as adding 2^3072 - p and dropping the carry. */
+void Num3072::fullReduce()
+{
+	uint64_t carry = g_maxPrimeDiff;
+	for (size_t i = 0; i < LIMBS; i++) {
+		carry += m_limbs[i];
+		m_limbs[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+}
+
+void Num3072::multiply(const Num3072& other)
+{
+	// Schoolbook product into 192 limbs. Each step is at most
+	// (2^32 - 1)^2 + 2 * (2^32 - 1) = 2^64 - 1, so it fits in uint64_t.
+	uint32_t product[2 * LIMBS] = {0};
+	for (size_t i = 0; i < LIMBS; i++) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < LIMBS; j++) {
+			uint64_t t = (uint64_t)m_limbs[i] * other.m_limbs[j] + product[i + j] + carry;
+			product[i + j] = (uint32_t)t;
+			carry = t >> 32;
+		}
+		product[i + LIMBS] = (uint32_t)carry;
+	}
+
+	// Fold the high half back in with 2^3072 = 2^3072 - p (mod p).
+	uint64_t carry = 0;
+	for (size_t i = 0; i < LIMBS; i++) {
+		carry += (uint64_t)product[i + LIMBS] * g_maxPrimeDiff + product[i];
+		m_limbs[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	// What is left above 3072 bits is below 2^21; fold it once more.
+	while (carry) {
+		uint64_t fold = carry * g_maxPrimeDiff;
+		carry = 0;
+		for (size_t i = 0; i < LIMBS && (fold || carry); i++) {
+			carry += (uint64_t)m_limbs[i] + (uint32_t)fold;
+			fold >>= 32;
+			m_limbs[i] = (uint32_t)carry;
+			carry >>= 32;
+		}
+	}
+	if (isOverflow()) {
+		fullReduce();
+	}
+}
+
+void Num3072::toBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+	for (size_t i = 0; i < LIMBS; i++) {
+		writeLE32(out + 4 * i, m_limbs[i]);
+	}
+}
+
+void MuHash3072::insert(const unsigned char* data, size_t len)
+{
+	// The element is hashed with SHA256 and expanded to 3072 bits with ChaCha20.
+	unsigned char hashed[Sha256::OUTPUT_SIZE];
+	Sha256().write(data, len).finalize(hashed);
+	unsigned char expanded[Num3072::BYTE_SIZE];
+	chacha20Keystream(hashed, expanded, sizeof(expanded));
+	m_numerator.multiply(Num3072(expanded));
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& other)
+{
+	m_numerator.multiply(other.m_numerator);
+	return *this;
+}
+
+void MuHash3072::finalize(unsigned char (&out)[32]) const
+{
+	unsigned char data[Num3072::BYTE_SIZE];
+	m_numerator.toBytes(data);
+	Sha256().write(data, sizeof(data)).finalize(out);
+}
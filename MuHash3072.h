@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * A 3072-bit number modulo the MuHash prime 2^3072 - 1103717, kept as 96
+ * little-endian 32-bit limbs.
+ * */
+class Num3072 {
+public:
+	static const size_t LIMBS = 96;
+	static const size_t BYTE_SIZE = 384;
+
+	Num3072();
+	explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+	void multiply(const Num3072& other);
+	void toBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+private:
+	bool isOverflow() const;
+	void fullReduce();
+
+private:
+	uint32_t m_limbs[LIMBS];
+};
+
+/**
+ * Rolling multiset hash of Bitcoin Core's MuHash3072, the algorithm behind
+ * `gettxoutsetinfo muhash`.
+ *
+ * Each element is hashed to a number mod p and multiplied into the running
+ * product. Multiplication is commutative, so accumulators filled from disjoint
+ * subsets of the UTXO set in any order combine into the same hash with *=.
+ * See: https://github.com/bitcoin/bitcoin/blob/v26.0/src/crypto/muhash.cpp
+ * */
+class MuHash3072 {
+public:
+	MuHash3072() = default;
+	void insert(const unsigned char* data, size_t len);
+	MuHash3072& operator*=(const MuHash3072& other);
+	void finalize(unsigned char (&out)[32]) const;
+
+private:
+	Num3072 m_numerator;
+};
@@ -0,0 +1,54 @@
+#include "PgCopyWriter.h"
+#include "Utxo.h"
+
+PgCopyWriter::PgCopyWriter(const std::filesystem::path& path)
+	: FileRecordWriter(path)
+{
+	// 11 byte signature, 32-bit flags (no OIDs) and 32-bit header extension length
+	static const char signature[] = "PGCOPY\n\377\r\n";
+	m_buffer.append(signature, sizeof(signature));
+	appendBE(0, 4);
+	appendBE(0, 4);
+}
+
+PgCopyWriter::~PgCopyWriter()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+/** All integers in the COPY binary format are in network byte order. */
+void PgCopyWriter::appendBE(uint64_t v, size_t bytes)
+{
+	for (size_t i = bytes; i-- > 0;) {
+		m_buffer.push_back(static_cast<char>(v >> (8 * i)));
+	}
+}
+
+void PgCopyWriter::write(const UTXO& utxo)
+{
+	const auto& script = utxo.getPublicKey();
+	// Field count, then a 32-bit length before each field's value
+	appendBE(4, 2);
+	appendBE(script.size(), 4);
+	m_buffer.append(script.begin(), script.end());
+	appendBE(8, 4);
+	appendBE(utxo.getAmount(), 8);
+	appendBE(4, 4);
+	appendBE(utxo.getHeight(), 4);
+	appendBE(1, 4);
+	m_buffer.push_back(utxo.isCoinbase() ? 1 : 0);
+	flushIfFull();
+}
+
+void PgCopyWriter::close()
+{
+	if (!m_trailerWritten) {
+		// A field count of -1 ends the data
+		appendBE(0xFFFF, 2);
+		m_trailerWritten = true;
+	}
+	FileRecordWriter::close();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "RecordWriter.h"
+
+/**
+ * PostgreSQL binary COPY format, so the server ingests raw bytes instead of
+ * parsing hex text. Every row has the columns
+ *
+ *     script bytea, amount int8, height int4, coinbase bool
+ *
+ * and loads with:
+ *
+ *     COPY utxo (script, amount, height, coinbase) FROM '/path/file' WITH (FORMAT binary);
+ *
+ * See: https://www.postgresql.org/docs/current/sql-copy.html#id-1.9.3.55.9.4
+ * */
+class PgCopyWriter : public FileRecordWriter {
+public:
+	explicit PgCopyWriter(const std::filesystem::path& path);
+	~PgCopyWriter() override;
+	void write(const UTXO& utxo) override;
+	void close() override;
+
+private:
+	void appendBE(uint64_t v, size_t bytes);
+	bool m_trailerWritten = false;
+};
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include "Prefetcher.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define UTXOPARSER_HAVE_FADVISE
+#endif
+
+namespace {
+/**
+ * Undo LevelDB's EscapeString: bytes from ' ' to '~' are kept, everything
+ * else is written as \xNN. A key byte '\' is not escaped though, so a key
+ * holding the text \xNN reads the same as the escaped byte. Since printable
+ * bytes are never escaped, \x41 and the like are kept as text; the rest is
+ * taken as an escape, which only leaves keys that hold a backslash, 'x' and
+ * two hex digits of a control byte misread.
+ * */
+std::string unescape(const std::string& s)
+{
+	std::string out;
+	for (size_t i = 0; i < s.size(); i++) {
+		if (s[i] == '\\' && i + 3 < s.size() && s[i + 1] == 'x' &&
+			isxdigit((unsigned char)s[i + 2]) && isxdigit((unsigned char)s[i + 3])) {
+			int byte = std::stoi(s.substr(i + 2, 2), nullptr, 16);
+			if (byte < ' ' || byte > '~') {
+				out.push_back(static_cast<char>(byte));
+				i += 3;
+				continue;
+			}
+		}
+		out.push_back(s[i]);
+	}
+	return out;
+}
+
+/** The user key of an InternalKey::DebugString(), "'key' @ sequence : type". */
+bool userKey(const std::string& debugString, std::string& key)
+{
+	size_t start = debugString.find('\'');
+	size_t end = debugString.rfind("' @ ");
+	if (start == std::string::npos || end == std::string::npos || end <= start) {
+		return false;
+	}
+	key = unescape(debugString.substr(start + 1, end - start - 1));
+	return true;
+}
+
+bool parseNumber(const std::string& s, uint64_t& value)
+{
+	char* pEnd;
+	value = strtoull(s.c_str(), &pEnd, 10);
+	return !s.empty() && isdigit((unsigned char)s[0]) && *pEnd == '\0';
+}
+}
+
+Prefetcher::Prefetcher(const std::filesystem::path& dbPath, const std::string& sstables, uint64_t window)
+	: m_dbPath(dbPath), m_window(window)
+{
+	bool keysValid;
+	m_files = parseTables(sstables, keysValid);
+	if (keysValid) {
+		std::stable_sort(m_files.begin(), m_files.end(), [](const TableFile& a, const TableFile& b) {
+			return a.smallest < b.smallest;
+		});
+	}
+	m_thread = std::thread(&Prefetcher::run, this);
+}
+
+Prefetcher::~Prefetcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done = true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+/**
+ * Parse the "leveldb.sstables" property, one line per table file:
+ *
+ *     --- level 1 ---
+ *      1234:2104523['C\x00\x01...' @ 5 : 1 .. 'C\x00\x07...' @ 9 : 1]
+ *
+ * The keys are only good for ordering the files if every line parses and
+ * they agree with how LevelDB keeps a level: from level 1 on, files are
+ * listed in key order and do not overlap. keysValid is false otherwise, and
+ * the files are then best taken in the order listed, level by level.
+ * */
+std::vector<Prefetcher::TableFile> Prefetcher::parseTables(const std::string& sstables, bool& keysValid)
+{
+	std::vector<TableFile> files;
+	keysValid = true;
+	int level = 0;
+	size_t pos = 0;
+	while (pos < sstables.size()) {
+		size_t eol = sstables.find('\n', pos);
+		if (eol == std::string::npos) {
+			eol = sstables.size();
+		}
+		std::string line = sstables.substr(pos, eol - pos);
+		pos = eol + 1;
+
+		if (line.rfind("--- level ", 0) == 0) {
+			level = atoi(line.c_str() + 10);
+			continue;
+		}
+		size_t first = line.find_first_not_of(' ');
+		if (first == std::string::npos) {
+			continue;
+		}
+		size_t colon = line.find(':');
+		size_t open = line.find('[');
+		size_t separator = line.find(" .. ", open == std::string::npos ? 0 : open);
+		size_t close = line.rfind(']');
+		TableFile file;
+		file.level = level;
+		if (colon == std::string::npos || open == std::string::npos || separator == std::string::npos ||
+			close == std::string::npos || colon > open || separator > close ||
+			!parseNumber(line.substr(first, colon - first), file.number) ||
+			!parseNumber(line.substr(colon + 1, open - colon - 1), file.size) ||
+			!userKey(line.substr(open + 1, separator - open - 1), file.smallest) ||
+			!userKey(line.substr(separator + 4, close - separator - 4), file.largest)) {
+			keysValid = false;
+			continue;
+		}
+		if (file.largest < file.smallest ||
+			(level > 0 && !files.empty() && files.back().level == level && !(files.back().largest < file.smallest))) {
+			keysValid = false;
+		}
+		files.push_back(file);
+	}
+	return files;
+}
+
+/** Called by the scan with the key it has reached. Cheap enough to call every few thousand keys. */
+void Prefetcher::advance(const std::string& key)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_position = key;
+		m_positionChanged = true;
+	}
+	m_wake.notify_one();
+}
+
+std::filesystem::path Prefetcher::tablePath(uint64_t number) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%06llu.ldb", static_cast<unsigned long long>(number));
+	std::filesystem::path path = m_dbPath / name;
+	if (!std::filesystem::exists(path)) {
+		// Tables written by LevelDB before 1.14 use the old extension
+		path.replace_extension(".sst");
+	}
+	return path;
+}
+
+void Prefetcher::willNeed(const TableFile& file)
+{
+#ifdef UTXOPARSER_HAVE_FADVISE
+	int fd = open(tablePath(file.number).c_str(), O_RDONLY);
+	if (fd >= 0) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		close(fd);
+	}
+#else
+	std::ifstream in(tablePath(file.number), std::ios::binary);
+	std::vector<char> buffer(1 << 20);
+	while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) {
+	}
+#endif
+}
+
+void Prefetcher::dontNeed(const TableFile& file)
+{
+#ifdef UTXOPARSER_HAVE_FADVISE
+	int fd = open(tablePath(file.number).c_str(), O_RDONLY);
+	if (fd >= 0) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#else
+	(void)file;
+#endif
+}
+
+void Prefetcher::run()
+{
+	// Files before next have been prefetched; released marks those the scan has passed.
+	size_t next = 0;
+	uint64_t ahead = 0;
+	std::vector<bool> released(m_files.size(), false);
+	std::string position;
+	for (;;) {
+		// Issue read-ahead until the window is full
+		while (next < m_files.size() && ahead < m_window) {
+			willNeed(m_files[next]);
+			ahead += m_files[next].size;
+			next++;
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_done) {
+				return;
+			}
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_done || m_positionChanged; });
+			if (m_done) {
+				return;
+			}
+			position = m_position;
+			m_positionChanged = false;
+		}
+
+		// Release the files that end before the scan position. Files of different
+		// levels overlap, so a wide file does not hold back the narrow ones after it.
+		for (size_t i = 0; i < next; i++) {
+			if (!released[i] && m_files[i].largest < position) {
+				dontNeed(m_files[i]);
+				ahead -= std::min(ahead, m_files[i].size);
+				released[i] = true;
+			}
+		}
+	}
+}
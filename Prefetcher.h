@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+
+/**
+ * Background read-ahead of LevelDB table files for a full scan.
+ *
+ * The table files are ordered by the smallest key they hold, taken from the
+ * "leveldb.sstables" property. As the scan reports its position, the files
+ * just ahead of it are handed to the OS with posix_fadvise(WILLNEED), up to
+ * the prefetch window. Files the scan has passed are dropped from the page
+ * cache again (DONTNEED), so a one-shot scan of a large chainstate does not
+ * evict everything else. The kernel can then stream whole files sequentially
+ * while the scan is still decoding the previous ones.
+ *
+ * The keys in that property are escaped text that can't always be read back
+ * exactly, so this is best-effort: a misread key only makes a file arrive or
+ * leave the cache early or late. When the keys don't parse or contradict the
+ * LevelDB layout, the files are taken in the order listed, level by level.
+ *
+ * Where posix_fadvise is not available, upcoming files are read in the
+ * background instead, which warms the OS cache the same way.
+ * */
+class Prefetcher {
+public:
+	struct TableFile {
+		int level;
+		uint64_t number;
+		uint64_t size;
+		std::string smallest;
+		std::string largest;
+	};
+
+	Prefetcher(const std::filesystem::path& dbPath, const std::string& sstables, uint64_t window);
+	~Prefetcher();
+	void advance(const std::string& key);
+	static std::vector<TableFile> parseTables(const std::string& sstables, bool& keysValid);
+
+private:
+	void run();
+	std::filesystem::path tablePath(uint64_t number) const;
+	void willNeed(const TableFile& file);
+	void dontNeed(const TableFile& file);
+
+private:
+	std::filesystem::path m_dbPath;
+	std::vector<TableFile> m_files;
+	uint64_t m_window;
+	std::string m_position;
+	bool m_positionChanged = false;
+	bool m_done = false;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::thread m_thread;
+};
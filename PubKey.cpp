@@ -0,0 +1,176 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "PubKey.h"
+
+namespace {
+// Field elements are 8 little-endian 32-bit limbs. 32-bit limbs keep the
+// products in uint64_t, which every compiler we build with supports.
+using FieldElem = std::array<uint32_t, 8>;
+
+// p = 2^256 - 2^32 - 977
+const FieldElem g_p = {0xFFFFFC2F, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF,
+                       0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+
+bool geP(const FieldElem& a)
+{
+	for (size_t i = 8; i-- > 0;) {
+		if (a[i] != g_p[i]) {
+			return a[i] > g_p[i];
+		}
+	}
+	return true;
+}
+
+void subP(FieldElem& a)
+{
+	int64_t borrow = 0;
+	for (size_t i = 0; i < 8; i++) {
+		int64_t t = (int64_t)a[i] - g_p[i] - borrow;
+		borrow = t < 0 ? 1 : 0;
+		a[i] = (uint32_t)t;
+	}
+}
+
+/**
+ * Reduce a little-endian number of up to 16 limbs modulo p, using
+ * 2^256 = 2^32 + 977 (mod p) to fold the high limbs back in.
+ * */
+FieldElem reduce(const uint32_t* limbs, size_t size)
+{
+	const size_t maxLimbs = 18;
+	uint32_t n[maxLimbs] = {0};
+	for (size_t i = 0; i < size; i++) {
+		n[i] = limbs[i];
+	}
+	while (size > 8) {
+		const size_t high = size - 8;
+		uint32_t folded[maxLimbs] = {0};
+		uint64_t carry = 0;
+		for (size_t i = 0; i < maxLimbs; i++) {
+			uint64_t t = carry;
+			if (i < 8) {
+				t += n[i];
+			}
+			if (i < high) {
+				t += (uint64_t)n[8 + i] * 977;
+			}
+			if (i >= 1 && i - 1 < high) {
+				t += n[8 + i - 1];
+			}
+			folded[i] = (uint32_t)t;
+			carry = t >> 32;
+		}
+		size = maxLimbs;
+		while (size > 8 && folded[size - 1] == 0) {
+			size--;
+		}
+		for (size_t i = 0; i < maxLimbs; i++) {
+			n[i] = folded[i];
+		}
+	}
+	FieldElem r;
+	for (size_t i = 0; i < 8; i++) {
+		r[i] = n[i];
+	}
+	while (geP(r)) {
+		subP(r);
+	}
+	return r;
+}
+
+FieldElem mul(const FieldElem& a, const FieldElem& b)
+{
+	uint32_t product[16] = {0};
+	for (size_t i = 0; i < 8; i++) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < 8; j++) {
+			uint64_t t = (uint64_t)a[i] * b[j] + product[i + j] + carry;
+			product[i + j] = (uint32_t)t;
+			carry = t >> 32;
+		}
+		product[i + 8] = (uint32_t)carry;
+	}
+	return reduce(product, 16);
+}
+
+FieldElem add7(const FieldElem& a)
+{
+	uint32_t n[9];
+	uint64_t carry = 7;
+	for (size_t i = 0; i < 8; i++) {
+		uint64_t t = (uint64_t)a[i] + carry;
+		n[i] = (uint32_t)t;
+		carry = t >> 32;
+	}
+	n[8] = (uint32_t)carry;
+	return reduce(n, 9);
+}
+
+/** a^((p + 1) / 4), the square root of a when one exists, since p = 3 (mod 4). */
+FieldElem sqrt(const FieldElem& a)
+{
+	// (p + 1) / 4 = 0x3FFFFFFF...FFFFFFFF BFFFFF0C
+	const FieldElem e = {0xBFFFFF0C, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+	                     0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x3FFFFFFF};
+	FieldElem r = {1, 0, 0, 0, 0, 0, 0, 0};
+	for (size_t i = 8; i-- > 0;) {
+		for (int bit = 31; bit >= 0; bit--) {
+			r = mul(r, r);
+			if ((e[i] >> bit) & 1) {
+				r = mul(r, a);
+			}
+		}
+	}
+	return r;
+}
+}
+
+namespace pubkey {
+bool decompress(const unsigned char* x, bool oddY, std::vector<unsigned char>& pubKey)
+{
+	FieldElem fx;
+	for (size_t i = 0; i < 8; i++) {
+		const unsigned char* limb = x + 28 - 4 * i;
+		fx[i] = ((uint32_t)limb[0] << 24) | ((uint32_t)limb[1] << 16) | ((uint32_t)limb[2] << 8) | limb[3];
+	}
+	if (geP(fx)) {
+		return false;
+	}
+
+	// y^2 = x^3 + 7
+	FieldElem y2 = add7(mul(mul(fx, fx), fx));
+	FieldElem y = sqrt(y2);
+	if (mul(y, y) != y2) {
+		return false;
+	}
+	if ((y[0] & 1) != (oddY ? 1u : 0u)) {
+		FieldElem zero = {0, 0, 0, 0, 0, 0, 0, 0};
+		if (y == zero) {
+			return false;
+		}
+		FieldElem negY = g_p;
+		int64_t borrow = 0;
+		for (size_t i = 0; i < 8; i++) {
+			int64_t t = (int64_t)negY[i] - y[i] - borrow;
+			borrow = t < 0 ? 1 : 0;
+			negY[i] = (uint32_t)t;
+		}
+		y = negY;
+	}
+
+	pubKey.resize(65);
+	pubKey[0] = 0x04;
+	for (size_t i = 0; i < 32; i++) {
+		pubKey[1 + i] = x[i];
+	}
+	for (size_t i = 0; i < 8; i++) {
+		unsigned char* limb = &pubKey[33 + 28 - 4 * i];
+		limb[0] = (unsigned char)(y[i] >> 24);
+		limb[1] = (unsigned char)(y[i] >> 16);
+		limb[2] = (unsigned char)(y[i] >> 8);
+		limb[3] = (unsigned char)y[i];
+	}
+	return true;
+}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+namespace pubkey {
+/**
+ * Recover the uncompressed secp256k1 public key (0x04 || x || y) from the
+ * x coordinate and the parity of y.
+ *
+ * Used to rebuild the scripts of the two special "uncompressed P2PK" script
+ * types, which LevelDB stores with the x coordinate only.
+ * See: https://github.com/bitcoin/bitcoin/blob/0.20/src/compressor.cpp#L120
+ *
+ * Returns false if x is not the coordinate of a point on the curve.
+ * */
+bool decompress(const unsigned char* x, bool oddY, std::vector<unsigned char>& pubKey);
+}
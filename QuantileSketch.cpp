@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "QuantileSketch.h"
+
+QuantileSketch::QuantileSketch(size_t k)
+	: m_k(k < 8 ? 8 : k), m_compactors(1)
+{
+}
+
+/** Capacities shrink by 2/3 per level below the top one, never under 2. */
+size_t QuantileSketch::capacity(size_t level) const
+{
+	size_t depth = m_compactors.size() - level - 1;
+	size_t c = static_cast<size_t>(std::ceil(m_k * std::pow(2.0 / 3.0, (double)depth)));
+	return c < 2 ? 2 : c;
+}
+
+size_t QuantileSketch::retained() const
+{
+	size_t n = 0;
+	for (const auto& c : m_compactors) {
+		n += c.size();
+	}
+	return n;
+}
+
+void QuantileSketch::add(uint64_t value)
+{
+	m_count++;
+	m_min = std::min(m_min, value);
+	m_max = std::max(m_max, value);
+	m_compactors[0].push_back(value);
+	if (m_compactors[0].size() >= capacity(0)) {
+		compress();
+	}
+}
+
+void QuantileSketch::compress()
+{
+	size_t total = 0;
+	for (size_t h = 0; h < m_compactors.size(); h++) {
+		total += capacity(h);
+	}
+
+	while (retained() >= total) {
+		for (size_t h = 0; h < m_compactors.size(); h++) {
+			if (m_compactors[h].size() < capacity(h)) {
+				continue;
+			}
+			if (h + 1 == m_compactors.size()) {
+				m_compactors.emplace_back();
+			}
+			auto& level = m_compactors[h];
+			std::sort(level.begin(), level.end());
+
+			// An odd item stays behind so that the promoted weight is exact.
+			uint64_t leftover = 0;
+			bool hasLeftover = level.size() % 2 == 1;
+			if (hasLeftover) {
+				leftover = level.back();
+				level.pop_back();
+			}
+			size_t offset = m_random() & 1;
+			auto& next = m_compactors[h + 1];
+			for (size_t i = offset; i < level.size(); i += 2) {
+				next.push_back(level[i]);
+			}
+			level.clear();
+			if (hasLeftover) {
+				level.push_back(leftover);
+			}
+			break;
+		}
+
+		total = 0;
+		for (size_t h = 0; h < m_compactors.size(); h++) {
+			total += capacity(h);
+		}
+	}
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+	if (other.m_count == 0) {
+		return;
+	}
+	while (m_compactors.size() < other.m_compactors.size()) {
+		m_compactors.emplace_back();
+	}
+	for (size_t h = 0; h < other.m_compactors.size(); h++) {
+		m_compactors[h].insert(m_compactors[h].end(), other.m_compactors[h].begin(), other.m_compactors[h].end());
+	}
+	m_count += other.m_count;
+	m_min = std::min(m_min, other.m_min);
+	m_max = std::max(m_max, other.m_max);
+	compress();
+}
+
+/**
+ * The smallest retained value whose weighted rank reaches q * count.
+ * */
+uint64_t QuantileSketch::quantile(double q) const
+{
+	if (m_count == 0) {
+		return 0;
+	}
+	if (q <= 0) {
+		return m_min;
+	}
+	if (q >= 1) {
+		return m_max;
+	}
+
+	std::vector<std::pair<uint64_t, uint64_t>> weighted;
+	weighted.reserve(retained());
+	uint64_t totalWeight = 0;
+	for (size_t h = 0; h < m_compactors.size(); h++) {
+		for (auto v : m_compactors[h]) {
+			weighted.emplace_back(v, uint64_t(1) << h);
+			totalWeight += uint64_t(1) << h;
+		}
+	}
+	std::sort(weighted.begin(), weighted.end());
+
+	const double target = q * (double)totalWeight;
+	uint64_t cumulative = 0;
+	for (const auto& w : weighted) {
+		cumulative += w.second;
+		if ((double)cumulative >= target) {
+			return w.first;
+		}
+	}
+	return m_max;
+}
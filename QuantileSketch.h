@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <random>
+
+/**
+ * KLL quantile sketch over uint64_t values.
+ *
+ * Keeps a stack of compactors, where an item at level h stands for 2^h input
+ * values. When the sketch is full, the lowest full compactor is sorted and
+ * every other item is promoted one level up. The rank error is about 1.7 / k
+ * with O(k) memory, whatever the input size. Sketches built on separate
+ * threads merge into one with the same guarantee.
+ * See: Karnin, Lang, Liberty, "Optimal Quantile Approximation in Streams" (2016)
+ * */
+class QuantileSketch {
+public:
+	explicit QuantileSketch(size_t k = 400);
+	void add(uint64_t value);
+	void merge(const QuantileSketch& other);
+	uint64_t quantile(double q) const;
+	uint64_t count() const {
+		return m_count;
+	}
+	uint64_t min() const {
+		return m_min;
+	}
+	uint64_t max() const {
+		return m_max;
+	}
+
+private:
+	size_t capacity(size_t level) const;
+	size_t retained() const;
+	void compress();
+
+private:
+	size_t m_k;
+	std::vector<std::vector<uint64_t>> m_compactors;
+	std::mt19937_64 m_random;
+	uint64_t m_count = 0;
+	uint64_t m_min = UINT64_MAX;
+	uint64_t m_max = 0;
+};
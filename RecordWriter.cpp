@@ -0,0 +1,63 @@
+#include "RecordWriter.h"
+#include "CsvWriter.h"
+#include "PgCopyWriter.h"
+#include "SqliteWriter.h"
+#include "DbWrapperException.h"
+
+std::unique_ptr<RecordWriter> RecordWriter::create(OutputFormat format, const std::filesystem::path& path)
+{
+	switch (format) {
+	case OutputFormat::PgCopy:
+		return std::make_unique<PgCopyWriter>(path);
+	case OutputFormat::Sqlite:
+		return std::make_unique<SqliteWriter>(path);
+	default:
+		return std::make_unique<CsvWriter>(path);
+	}
+}
+
+FileRecordWriter::FileRecordWriter(const std::filesystem::path& path)
+	: m_file(path, std::ios::binary)
+{
+	if (!m_file) {
+		std::string errMsg("Can't create the output file ");
+		errMsg += path.string();
+		throw DbWrapperException(errMsg.c_str());
+	}
+	m_buffer.reserve(m_flushThreshold + 256);
+}
+
+FileRecordWriter::~FileRecordWriter()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void FileRecordWriter::flushIfFull()
+{
+	if (m_buffer.size() >= m_flushThreshold) {
+		flush();
+	}
+}
+
+void FileRecordWriter::flush()
+{
+	if (m_buffer.empty()) {
+		return;
+	}
+	m_file.write(m_buffer.data(), m_buffer.size());
+	m_buffer.clear();
+	if (!m_file) {
+		throw DbWrapperException("Can't write to the output file");
+	}
+}
+
+void FileRecordWriter::close()
+{
+	if (m_file.is_open()) {
+		flush();
+		m_file.close();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <fstream>
+#include <filesystem>
+
+class UTXO;
+
+/** The file format coins are exported in. */
+enum class OutputFormat {
+	Csv,     // scriptPubKey hex and amount, one coin per line
+	PgCopy,  // PostgreSQL binary COPY: script bytea, amount int8, height int4, coinbase bool
+	Sqlite,  // SQLite database with a utxo(script, amount, height, coinbase) table
+};
+
+/**
+ * Writes exported coins to one output file in a given format.
+ * */
+class RecordWriter {
+public:
+	virtual ~RecordWriter() = default;
+	virtual void write(const UTXO& utxo) = 0;
+	virtual void close() = 0;
+	static std::unique_ptr<RecordWriter> create(OutputFormat format, const std::filesystem::path& path);
+};
+
+/**
+ * Base for the writers that produce a flat file. Records are appended to an
+ * in-memory buffer that is written out in blocks of about 1 MiB.
+ * */
+class FileRecordWriter : public RecordWriter {
+public:
+	explicit FileRecordWriter(const std::filesystem::path& path);
+	~FileRecordWriter() override;
+	void close() override;
+
+protected:
+	void flushIfFull();
+	void flush();
+
+protected:
+	static const size_t m_flushThreshold = 1 << 20;
+	std::string m_buffer;
+
+private:
+	std::ofstream m_file;
+};
@@ -0,0 +1,531 @@
+#include <thread>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <cctype>
+#include <stdexcept>
+#include "ResidentUtxoSet.h"
+#include "DbWrapper.h"
+#include "Utxo.h"
+#include "PubKey.h"
+#include "utils.h"
+
+namespace {
+const uint32_t g_amountOverflow = UINT32_MAX;
+const uint16_t g_voutOverflow = UINT16_MAX;
+// A script id is the class in the top bits and the index in its pool below
+const uint32_t g_classShift = 28;
+const uint32_t g_indexMask = (1u << g_classShift) - 1;
+const uint32_t g_noScript = UINT32_MAX;
+
+/** A whole decimal number, rejecting signs, trailing text and overflow. */
+bool parseNumber(const std::string& s, uint64_t& value)
+{
+	if (s.empty() || !isdigit(static_cast<unsigned char>(s[0]))) {
+		return false;
+	}
+	char* pEnd;
+	errno = 0;
+	value = strtoull(s.c_str(), &pEnd, 10);
+	return *pEnd == '\0' && errno != ERANGE;
+}
+
+uint64_t scriptHash(unsigned char cls, const unsigned char* payload, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL ^ cls;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= payload[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+}
+
+ResidentUtxoSet::ResidentUtxoSet(DBWrapper& db, size_t partitions)
+	: m_db(db), m_partitions(partitions == 0 ? 1 : partitions > 256 ? 256 : partitions)
+{
+}
+
+void ResidentUtxoSet::load()
+{
+	m_db.forEachUTXO(m_partitions.size(), [this](size_t p, const BytesVec& txid, uint32_t vout, const UTXO& utxo) {
+		uint32_t heightCode = static_cast<uint32_t>((utxo.getHeight() << 1) | (utxo.isCoinbase() ? 1 : 0));
+		m_partitions[p].add(txid, vout, utxo.getAmount(), heightCode, utxo.getPublicKey());
+	});
+	for (auto& partition : m_partitions) {
+		partition.shrink();
+	}
+}
+
+size_t ResidentUtxoSet::size() const
+{
+	size_t n = 0;
+	for (const auto& partition : m_partitions) {
+		n += partition.txidPrefix.size();
+	}
+	return n;
+}
+
+size_t ResidentUtxoSet::memoryUsage() const
+{
+	size_t n = 0;
+	for (const auto& partition : m_partitions) {
+		n += partition.memoryUsage();
+	}
+	return n;
+}
+
+/**
+ * Split a script into its class and the bytes that have to be stored for it:
+ * the hash or key of a standard script, or the whole script otherwise. The
+ * type comes from UTXO::classifyScript, P2PK is split further by key parity.
+ * */
+unsigned char ResidentUtxoSet::classify(const BytesVec& script, BytesVec& payload)
+{
+	const unsigned char* s = script.data();
+	switch (UTXO::classifyScript(script)) {
+	case ScriptType::P2PKH:
+		payload.assign(s + 3, s + 23);
+		return P2PKH;
+	case ScriptType::P2SH:
+		payload.assign(s + 2, s + 22);
+		return P2SH;
+	case ScriptType::P2PK:
+		if (script.size() == 35) {
+			payload.assign(s + 2, s + 34);
+			return s[1] == 0x02 ? P2PK_EVEN : P2PK_ODD;
+		} else {
+			// Only keep the x coordinate if y can be recovered from it exactly
+			BytesVec pubKey;
+			bool odd = s[65] & 1;
+			if (pubkey::decompress(s + 2, odd, pubKey) && memcmp(pubKey.data(), s + 1, 65) == 0) {
+				payload.assign(s + 2, s + 34);
+				return odd ? P2PK_UNCOMPRESSED_ODD : P2PK_UNCOMPRESSED_EVEN;
+			}
+		}
+		break;
+	case ScriptType::P2WPKH:
+		payload.assign(s + 2, s + 22);
+		return P2WPKH;
+	case ScriptType::P2WSH:
+		payload.assign(s + 2, s + 34);
+		return P2WSH;
+	case ScriptType::P2TR:
+		payload.assign(s + 2, s + 34);
+		return P2TR;
+	default:
+		break;
+	}
+	payload = script;
+	return OTHER;
+}
+
+/** The script type of the scripts kept in a class; OTHER holds scripts of any type. */
+ScriptType ResidentUtxoSet::scriptType(unsigned char cls)
+{
+	static const ScriptType types[] = {
+		ScriptType::P2PKH, ScriptType::P2SH, ScriptType::P2PK, ScriptType::P2PK, ScriptType::P2PK,
+		ScriptType::P2PK, ScriptType::P2WPKH, ScriptType::P2WSH, ScriptType::P2TR, ScriptType::Other,
+	};
+	return types[cls];
+}
+
+/** Payload bytes stored for a script of this class, 0 if the whole script is kept. */
+size_t ResidentUtxoSet::payloadSize(unsigned char cls)
+{
+	switch (cls) {
+	case P2PKH:
+	case P2SH:
+	case P2WPKH:
+		return 20;
+	case OTHER:
+		return 0;
+	default:
+		return 32;
+	}
+}
+
+void ResidentUtxoSet::Partition::add(const BytesVec& txid, uint32_t voutIndex, uint64_t value, uint32_t height,
+	const BytesVec& script)
+{
+	const uint32_t index = static_cast<uint32_t>(txidPrefix.size());
+
+	// Keys are ordered by the txid in its internal byte order, the reverse of txid
+	uint64_t prefix = 0;
+	for (size_t i = 0; i < 8; i++) {
+		prefix = (prefix << 8) | txid[txid.size() - 1 - i];
+	}
+	txidPrefix.push_back(prefix);
+	if (voutIndex < g_voutOverflow) {
+		vout.push_back(static_cast<uint16_t>(voutIndex));
+	} else {
+		vout.push_back(g_voutOverflow);
+		voutOverflow[index] = voutIndex;
+	}
+
+	uint64_t compressed = UTXO::CompressAmount(value);
+	if (compressed < g_amountOverflow) {
+		amount.push_back(static_cast<uint32_t>(compressed));
+	} else {
+		amount.push_back(g_amountOverflow);
+		amountOverflow[index] = value;
+	}
+	heightCode.push_back(height);
+
+	BytesVec payload;
+	unsigned char cls = classify(script, payload);
+	scriptId.push_back(internScript(cls, payload));
+}
+
+uint32_t ResidentUtxoSet::Partition::voutAt(size_t i) const
+{
+	if (vout[i] == g_voutOverflow) {
+		return voutOverflow.at(static_cast<uint32_t>(i));
+	}
+	return vout[i];
+}
+
+uint64_t ResidentUtxoSet::Partition::amountAt(size_t i) const
+{
+	if (amount[i] == g_amountOverflow) {
+		return amountOverflow.at(static_cast<uint32_t>(i));
+	}
+	return UTXO::DecompressAmount(amount[i]);
+}
+
+const unsigned char* ResidentUtxoSet::Partition::payloadOf(uint32_t id, size_t& size) const
+{
+	const unsigned char cls = static_cast<unsigned char>(id >> g_classShift);
+	const uint32_t index = id & g_indexMask;
+	if (cls == OTHER) {
+		size = otherOffsets[index + 1] - otherOffsets[index];
+		return payloads[OTHER].data() + otherOffsets[index];
+	}
+	size = payloadSize(cls);
+	return payloads[cls].data() + index * size;
+}
+
+/** The slot holding this script's id, or the empty slot where it would go. */
+size_t ResidentUtxoSet::Partition::findSlot(unsigned char cls, const unsigned char* payload, size_t size) const
+{
+	const size_t mask = scriptSlots.size() - 1;
+	for (size_t slot = scriptHash(cls, payload, size) & mask;; slot = (slot + 1) & mask) {
+		uint32_t id = scriptSlots[slot];
+		if (id == g_noScript) {
+			return slot;
+		}
+		size_t idSize;
+		const unsigned char* idPayload = payloadOf(id, idSize);
+		if ((id >> g_classShift) == cls && idSize == size && (size == 0 || memcmp(idPayload, payload, size) == 0)) {
+			return slot;
+		}
+	}
+}
+
+void ResidentUtxoSet::Partition::growSlots()
+{
+	std::vector<uint32_t> old;
+	old.swap(scriptSlots);
+	scriptSlots.assign(old.empty() ? 1024 : old.size() * 2, g_noScript);
+	for (uint32_t id : old) {
+		if (id != g_noScript) {
+			size_t size;
+			const unsigned char* payload = payloadOf(id, size);
+			scriptSlots[findSlot(static_cast<unsigned char>(id >> g_classShift), payload, size)] = id;
+		}
+	}
+}
+
+/** The id of a script, g_noScript if no coin of the partition has it. */
+uint32_t ResidentUtxoSet::Partition::findScript(unsigned char cls, const BytesVec& payload) const
+{
+	if (scriptSlots.empty()) {
+		return g_noScript;
+	}
+	return scriptSlots[findSlot(cls, payload.data(), payload.size())];
+}
+
+/** The id of a script, adding it to its pool the first time it is seen. */
+uint32_t ResidentUtxoSet::Partition::internScript(unsigned char cls, const BytesVec& payload)
+{
+	// Keep the set at most half full
+	if ((scriptCount + 1) * 2 > scriptSlots.size()) {
+		growSlots();
+	}
+	size_t slot = findSlot(cls, payload.data(), payload.size());
+	if (scriptSlots[slot] != g_noScript) {
+		return scriptSlots[slot];
+	}
+
+	size_t index;
+	if (cls == OTHER) {
+		if (otherOffsets.empty()) {
+			otherOffsets.push_back(0);
+		}
+		index = otherOffsets.size() - 1;
+		payloads[OTHER].insert(payloads[OTHER].end(), payload.begin(), payload.end());
+		otherOffsets.push_back(payloads[OTHER].size());
+	} else {
+		index = payloads[cls].size() / payload.size();
+		payloads[cls].insert(payloads[cls].end(), payload.begin(), payload.end());
+	}
+	if (index > g_indexMask) {
+		throw std::length_error{"Too many distinct scripts of one class in a partition"};
+	}
+	uint32_t id = (static_cast<uint32_t>(cls) << g_classShift) | static_cast<uint32_t>(index);
+	scriptSlots[slot] = id;
+	scriptCount++;
+	return id;
+}
+
+void ResidentUtxoSet::Partition::shrink()
+{
+	txidPrefix.shrink_to_fit();
+	vout.shrink_to_fit();
+	amount.shrink_to_fit();
+	heightCode.shrink_to_fit();
+	scriptId.shrink_to_fit();
+	for (auto& pool : payloads) {
+		pool.shrink_to_fit();
+	}
+	otherOffsets.shrink_to_fit();
+}
+
+size_t ResidentUtxoSet::Partition::memoryUsage() const
+{
+	size_t n = txidPrefix.capacity() * sizeof(uint64_t) + vout.capacity() * sizeof(uint16_t) +
+		voutOverflow.size() * 32 + amount.capacity() * sizeof(uint32_t) + amountOverflow.size() * 32 +
+		heightCode.capacity() * sizeof(uint32_t) + scriptId.capacity() * sizeof(uint32_t) +
+		otherOffsets.capacity() * sizeof(uint64_t) + scriptSlots.capacity() * sizeof(uint32_t);
+	for (const auto& pool : payloads) {
+		n += pool.capacity();
+	}
+	return n;
+}
+
+/** The partition holding txids starting with this byte, as split by DBWrapper::forEachUTXO. */
+size_t ResidentUtxoSet::partitionOf(unsigned char firstTxidByte) const
+{
+	const size_t n = m_partitions.size();
+	size_t p = 0;
+	while (p + 1 < n && (p + 1) * 256 / n <= firstTxidByte) {
+		p++;
+	}
+	return p;
+}
+
+template <typename F>
+void ResidentUtxoSet::forEachPartition(F f) const
+{
+	std::vector<std::thread> threads;
+	for (size_t p = 0; p < m_partitions.size(); p++) {
+		threads.emplace_back([&f, this, p] { f(p, m_partitions[p]); });
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+}
+
+/**
+ * Answer one query per line until "quit" or the end of the input.
+ * */
+void ResidentUtxoSet::serve(std::istream& in, std::ostream& out)
+{
+	out << "Loaded " << size() << " coins in " << memoryUsage() / (1024 * 1024) << " MiB. Type help for the queries."
+		<< std::endl;
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream args(line);
+		std::string command;
+		args >> command;
+		try {
+			if (command.empty()) {
+				continue;
+			} else if (command == "quit" || command == "exit") {
+				break;
+			} else if (command == "lookup") {
+				std::string outpoint;
+				args >> outpoint;
+				lookup(outpoint, out);
+			} else if (command == "summary") {
+				summary(out);
+			} else if (command == "balance") {
+				std::string script;
+				args >> script;
+				balance(script, out);
+			} else if (command == "amount" || command == "height") {
+				std::string first, second, extra;
+				args >> first >> second >> extra;
+				uint64_t from = 0, to = UINT64_MAX;
+				if (!parseNumber(first, from) || (!second.empty() && !parseNumber(second, to)) || !extra.empty()) {
+					out << "error: expected " << command << (command == "amount" ? " MIN [MAX]" : " FROM [TO]") << "\n";
+				} else if (command == "amount") {
+					amountRange(from, to, out);
+				} else {
+					heightRange(from, to, out);
+				}
+			} else {
+				out << "lookup TXID:VOUT     the coin at this outpoint\n"
+					<< "summary              coins and total amount per script type\n"
+					<< "balance SCRIPTHEX    coins and total amount held by a scriptPubKey\n"
+					<< "amount MIN [MAX]     coins and total amount with MIN <= amount <= MAX satoshis\n"
+					<< "height FROM [TO]     coins and total amount created in blocks FROM to TO\n"
+					<< "quit\n";
+			}
+		} catch (const std::exception& e) {
+			out << "error: " << e.what() << "\n";
+		}
+		out << std::flush;
+	}
+}
+
+void ResidentUtxoSet::lookup(const std::string& outpoint, std::ostream& out)
+{
+	size_t colon = outpoint.find(':');
+	if (colon != 64) {
+		out << "error: expected TXID:VOUT\n";
+		return;
+	}
+	BytesVec txid;
+	utils::hexstringToBytes(outpoint.substr(0, 64), txid);
+	uint32_t voutIndex = static_cast<uint32_t>(std::stoul(outpoint.substr(colon + 1)));
+
+	uint64_t prefix = 0;
+	for (size_t i = 0; i < 8; i++) {
+		prefix = (prefix << 8) | txid[31 - i];
+	}
+	const Partition& partition = m_partitions[partitionOf(txid[31])];
+	auto range = std::equal_range(partition.txidPrefix.begin(), partition.txidPrefix.end(), prefix);
+	bool candidate = false;
+	for (auto it = range.first; it != range.second && !candidate; ++it) {
+		candidate = partition.voutAt(it - partition.txidPrefix.begin()) == voutIndex;
+	}
+
+	// Without a coin with this prefix and index the outpoint is not in the set. A match
+	// only covers 8 bytes of the txid, so the coin is confirmed by its full key.
+	std::unique_ptr<UTXO> utxo;
+	if (candidate) {
+		utxo = m_db.findUTXO(txid, voutIndex);
+	}
+	if (!utxo) {
+		out << "not found\n";
+		return;
+	}
+	const BytesVec& script = utxo->getPublicKey();
+	const uint64_t value = utxo->getAmount();
+	const uint64_t height = utxo->getHeight();
+	const bool coinbase = utxo->isCoinbase();
+	std::string scriptStr;
+	utils::bytesToHexstring(script, scriptStr);
+	out << "script " << scriptStr << " amount " << value << " height " << height
+		<< " coinbase " << (coinbase ? "yes" : "no") << "\n";
+}
+
+void ResidentUtxoSet::summary(std::ostream& out) const
+{
+	const size_t types = static_cast<size_t>(ScriptType::Count);
+	struct Totals {
+		uint64_t coins[static_cast<size_t>(ScriptType::Count)] = {0};
+		uint64_t amount[static_cast<size_t>(ScriptType::Count)] = {0};
+	};
+	std::vector<Totals> totals(m_partitions.size());
+	forEachPartition([&totals](size_t p, const Partition& partition) {
+		// Whole scripts can be of any type, e.g. P2PK with a key that isn't on the curve
+		std::vector<ScriptType> otherTypes;
+		for (size_t index = 0; index + 1 < partition.otherOffsets.size(); index++) {
+			auto script = partition.payloads[OTHER].begin();
+			otherTypes.push_back(UTXO::classifyScript(BytesVec(script + partition.otherOffsets[index],
+				script + partition.otherOffsets[index + 1])));
+		}
+		for (size_t i = 0; i < partition.txidPrefix.size(); i++) {
+			const uint32_t id = partition.scriptId[i];
+			const unsigned char cls = static_cast<unsigned char>(id >> g_classShift);
+			const size_t type = static_cast<size_t>(cls == OTHER ? otherTypes[id & g_indexMask] : scriptType(cls));
+			totals[p].coins[type]++;
+			totals[p].amount[type] += partition.amountAt(i);
+		}
+	});
+	uint64_t coins = 0, amount = 0;
+	for (size_t type = 0; type < types; type++) {
+		uint64_t typeCoins = 0, typeAmount = 0;
+		for (const auto& t : totals) {
+			typeCoins += t.coins[type];
+			typeAmount += t.amount[type];
+		}
+		out << UTXO::scriptTypeName(static_cast<ScriptType>(type)) << " coins " << typeCoins
+			<< " amount " << typeAmount << "\n";
+		coins += typeCoins;
+		amount += typeAmount;
+	}
+	out << "Total coins " << coins << " amount " << amount << "\n";
+}
+
+void ResidentUtxoSet::balance(const std::string& scriptHex, std::ostream& out) const
+{
+	BytesVec script, payload;
+	utils::hexstringToBytes(scriptHex, script);
+	unsigned char cls = classify(script, payload);
+
+	std::vector<std::pair<uint64_t, uint64_t>> totals(m_partitions.size());
+	forEachPartition([&](size_t p, const Partition& partition) {
+		// Coins of the same script share its id, so only the id has to be compared
+		const uint32_t id = partition.findScript(cls, payload);
+		if (id == g_noScript) {
+			return;
+		}
+		for (size_t i = 0; i < partition.scriptId.size(); i++) {
+			if (partition.scriptId[i] == id) {
+				totals[p].first++;
+				totals[p].second += partition.amountAt(i);
+			}
+		}
+	});
+	uint64_t coins = 0, amount = 0;
+	for (const auto& t : totals) {
+		coins += t.first;
+		amount += t.second;
+	}
+	out << "coins " << coins << " amount " << amount << "\n";
+}
+
+void ResidentUtxoSet::amountRange(uint64_t min, uint64_t max, std::ostream& out) const
+{
+	std::vector<std::pair<uint64_t, uint64_t>> totals(m_partitions.size());
+	forEachPartition([&](size_t p, const Partition& partition) {
+		for (size_t i = 0; i < partition.amount.size(); i++) {
+			uint64_t value = partition.amountAt(i);
+			if (value >= min && value <= max) {
+				totals[p].first++;
+				totals[p].second += value;
+			}
+		}
+	});
+	uint64_t coins = 0, amount = 0;
+	for (const auto& t : totals) {
+		coins += t.first;
+		amount += t.second;
+	}
+	out << "coins " << coins << " amount " << amount << "\n";
+}
+
+void ResidentUtxoSet::heightRange(uint64_t from, uint64_t to, std::ostream& out) const
+{
+	std::vector<std::pair<uint64_t, uint64_t>> totals(m_partitions.size());
+	forEachPartition([&](size_t p, const Partition& partition) {
+		for (size_t i = 0; i < partition.heightCode.size(); i++) {
+			uint64_t height = partition.heightCode[i] >> 1;
+			if (height >= from && height <= to) {
+				totals[p].first++;
+				totals[p].second += partition.amountAt(i);
+			}
+		}
+	});
+	uint64_t coins = 0, amount = 0;
+	for (const auto& t : totals) {
+		coins += t.first;
+		amount += t.second;
+	}
+	out << "coins " << coins << " amount " << amount << "\n";
+}
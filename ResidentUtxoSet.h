@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <unordered_map>
+#include "Utxo.h"
+
+class DBWrapper;
+
+/**
+ * The UTXO set loaded once into a compact struct-of-arrays, answering
+ * repeated lookup, filter and aggregate queries from memory instead of
+ * rescanning the chainstate for each question.
+ *
+ * A coin takes 22 bytes:
+ *  - the first 8 bytes of its txid,
+ *  - its output index in 16 bits, with a side table for larger ones,
+ *  - the compressed amount in 32 bits, with a side table for the few that
+ *    need more,
+ *  - height * 2 + coinbase,
+ *  - the id of its script.
+ * Each distinct script is stored once per partition, in a pool for its
+ * class. Standard scripts keep only their 20 or 32 byte hash or key, anything
+ * else keeps the full script. The script id is the class in the top 4 bits
+ * and the index in that pool below, so coins of a reused address share one
+ * payload. A hash set of script ids finds a script's id when loading and
+ * for balance queries.
+ *
+ * For the ~180M coins of mainnet the per-coin arrays take about 4 GB. Each
+ * distinct script adds its payload and 8 to 16 bytes of hash set, 30 to 50
+ * bytes for a standard script.
+ *
+ * The set is split into the same txid-range partitions the load scan uses,
+ * kept in key order, and every aggregate query runs one thread per partition.
+ * Lookups binary search the txid prefix, which answers "not found" from
+ * memory. A match only covers 8 bytes of the txid, so the coin is then read
+ * back from LevelDB by its full key before it is reported.
+ * */
+class ResidentUtxoSet {
+public:
+	ResidentUtxoSet(DBWrapper& db, size_t partitions);
+	void load();
+	void serve(std::istream& in, std::ostream& out);
+	size_t size() const;
+	size_t memoryUsage() const;
+
+private:
+	enum ScriptClass : unsigned char {
+		P2PKH = 0,
+		P2SH = 1,
+		P2PK_EVEN = 2,
+		P2PK_ODD = 3,
+		P2PK_UNCOMPRESSED_EVEN = 4,
+		P2PK_UNCOMPRESSED_ODD = 5,
+		P2WPKH = 6,
+		P2WSH = 7,
+		P2TR = 8,
+		OTHER = 9,
+		SCRIPT_CLASSES,
+	};
+
+	struct Partition {
+		std::vector<uint64_t> txidPrefix;
+		std::vector<uint16_t> vout;
+		std::unordered_map<uint32_t, uint32_t> voutOverflow;
+		std::vector<uint32_t> amount;
+		std::unordered_map<uint32_t, uint64_t> amountOverflow;
+		std::vector<uint32_t> heightCode;
+		std::vector<uint32_t> scriptId;
+		// Distinct scripts: fixed size payloads per class, whole scripts for OTHER
+		std::array<std::vector<unsigned char>, SCRIPT_CLASSES> payloads;
+		std::vector<uint64_t> otherOffsets;
+		// Open addressing hash set of script ids
+		std::vector<uint32_t> scriptSlots;
+		size_t scriptCount = 0;
+
+		void add(const std::vector<unsigned char>& txid, uint32_t vout, uint64_t amount, uint32_t heightCode,
+			const std::vector<unsigned char>& script);
+		uint32_t voutAt(size_t i) const;
+		uint64_t amountAt(size_t i) const;
+		const unsigned char* payloadOf(uint32_t id, size_t& size) const;
+		uint32_t findScript(unsigned char cls, const std::vector<unsigned char>& payload) const;
+		uint32_t internScript(unsigned char cls, const std::vector<unsigned char>& payload);
+		void shrink();
+		size_t memoryUsage() const;
+
+	private:
+		size_t findSlot(unsigned char cls, const unsigned char* payload, size_t size) const;
+		void growSlots();
+	};
+
+	static unsigned char classify(const std::vector<unsigned char>& script, std::vector<unsigned char>& payload);
+	static ScriptType scriptType(unsigned char cls);
+	static size_t payloadSize(unsigned char cls);
+	size_t partitionOf(unsigned char firstTxidByte) const;
+	template <typename F>
+	void forEachPartition(F f) const;
+
+	void lookup(const std::string& outpoint, std::ostream& out);
+	void summary(std::ostream& out) const;
+	void balance(const std::string& scriptHex, std::ostream& out) const;
+	void amountRange(uint64_t min, uint64_t max, std::ostream& out) const;
+	void heightRange(uint64_t from, uint64_t to, std::ostream& out) const;
+
+private:
+	DBWrapper& m_db;
+	std::vector<Partition> m_partitions;
+};
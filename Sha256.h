@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Incremental SHA-256, enough to reproduce Bitcoin Core's UTXO set hashes
+ * without pulling in a crypto library.
+ * */
+class Sha256 {
+public:
+	static const size_t OUTPUT_SIZE = 32;
+
+	Sha256();
+	Sha256& write(const unsigned char* data, size_t len);
+	void finalize(unsigned char hash[OUTPUT_SIZE]);
+	void reset();
+
+private:
+	void transform(const unsigned char* chunk);
+
+private:
+	uint32_t m_state[8];
+	unsigned char m_buf[64];
+	uint64_t m_bytes;
+};
@@ -0,0 +1,52 @@
+#include <stdexcept>
+#include "ShardedWriter.h"
+
+ShardedWriter::ShardedWriter(const std::filesystem::path& path, size_t shardCount, OutputFormat format)
+{
+	if (shardCount == 0) {
+		throw std::invalid_argument{"The number of shards must be at least 1"};
+	}
+
+	for (size_t i = 0; i < shardCount; i++) {
+		m_writers.push_back(RecordWriter::create(format, shardPath(path, i, shardCount)));
+	}
+}
+
+std::filesystem::path ShardedWriter::shardPath(const std::filesystem::path& path, size_t shard, size_t shardCount)
+{
+	if (shardCount == 1) {
+		return path;
+	}
+	std::filesystem::path p = path;
+	std::string name = path.stem().string();
+	name += "." + std::to_string(shard);
+	name += path.extension().string();
+	return p.replace_filename(name);
+}
+
+/**
+ * FNV-1a over the shard key. Stable across runs and platforms, so the same
+ * script always lands in the same shard for a given shard count.
+ * */
+size_t ShardedWriter::shardOf(const std::vector<unsigned char>& shardKey, size_t shardCount)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (auto b : shardKey) {
+		hash ^= b;
+		hash *= 0x100000001b3ULL;
+	}
+	return static_cast<size_t>(hash % shardCount);
+}
+
+void ShardedWriter::write(const std::vector<unsigned char>& shardKey, const UTXO& utxo)
+{
+	size_t shard = m_writers.size() == 1 ? 0 : shardOf(shardKey, m_writers.size());
+	m_writers[shard]->write(utxo);
+}
+
+void ShardedWriter::close()
+{
+	for (auto& writer : m_writers) {
+		writer->close();
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <filesystem>
+#include "RecordWriter.h"
+
+/**
+ * Routes exported coins to one of N files by a hash of a shard key.
+ *
+ * Each shard has its own RecordWriter and therefore its own buffer, so
+ * records are written in large blocks per file. With a single shard the
+ * coins go to the given path unchanged; otherwise shard i is written to
+ * "<stem>.<i><extension>" next to it.
+ * */
+class ShardedWriter {
+public:
+	ShardedWriter(const std::filesystem::path& path, size_t shardCount, OutputFormat format = OutputFormat::Csv);
+	void write(const std::vector<unsigned char>& shardKey, const UTXO& utxo);
+	void close();
+	size_t shardCount() const {
+		return m_writers.size();
+	}
+	static std::filesystem::path shardPath(const std::filesystem::path& path, size_t shard, size_t shardCount);
+	static size_t shardOf(const std::vector<unsigned char>& shardKey, size_t shardCount);
+
+private:
+	std::vector<std::unique_ptr<RecordWriter>> m_writers;
+};
@@ -0,0 +1,214 @@
+#include <cstring>
+#include <algorithm>
+#include "SnapshotReader.h"
+#include "DbWrapperException.h"
+#include "ShardedWriter.h"
+#include "UtxoCommitment.h"
+#include "Utxo.h"
+#include "utils.h"
+
+namespace {
+const unsigned char g_snapshotMagic[] = {'u', 't', 'x', 'o', 0xff};
+const uint64_t g_snapshotVersion = 2;
+// Far above any script the chainstate keeps, only there to reject corrupt sizes
+const uint64_t g_maxScriptSize = 1 << 20;
+}
+
+SnapshotReader::SnapshotReader(const std::filesystem::path& path)
+{
+	// Reads go straight into m_buffer, in blocks of m_readSize
+	m_file.rdbuf()->pubsetbuf(nullptr, 0);
+	m_file.open(path, std::ios::binary);
+	if (!m_file) {
+		std::string errMsg("Can't open the snapshot file ");
+		errMsg += path.string();
+		throw DbWrapperException(errMsg.c_str());
+	}
+	m_buffer.resize(m_readSize);
+	readHeader();
+}
+
+void SnapshotReader::readHeader()
+{
+	if (fill(sizeof(g_snapshotMagic)) && memcmp(&m_buffer[m_begin], g_snapshotMagic, sizeof(g_snapshotMagic)) == 0) {
+		take(sizeof(g_snapshotMagic));
+		uint64_t version = readLE(2);
+		if (version != g_snapshotVersion) {
+			throw DbWrapperException("Unsupported snapshot file version");
+		}
+		take(4); // network magic
+		m_grouped = true;
+	}
+	const unsigned char* hash = take(32);
+	m_baseBlockHash.assign(hash, hash + 32);
+	m_coinsCount = readLE(8);
+}
+
+/** The hash of the block the snapshot was taken at. */
+void SnapshotReader::getBestBlockHash(std::string& hash) const
+{
+	BytesVec baseBlockHash = m_baseBlockHash;
+	utils::switchEndianness(baseBlockHash);
+	utils::bytesToHexstring(baseBlockHash, hash);
+}
+
+/**
+ * Make at least n unread bytes available in the buffer, moving the unread
+ * tail to the front and reading the next block when needed. Returns false
+ * at the end of the file.
+ * */
+bool SnapshotReader::fill(size_t n)
+{
+	if (m_end - m_begin >= n) {
+		return true;
+	}
+	std::copy(m_buffer.begin() + m_begin, m_buffer.begin() + m_end, m_buffer.begin());
+	m_end -= m_begin;
+	m_begin = 0;
+	if (n > m_buffer.size()) {
+		m_buffer.resize(n);
+	}
+	while (m_end < n && m_file) {
+		m_file.read(reinterpret_cast<char*>(&m_buffer[m_end]), m_buffer.size() - m_end);
+		m_end += static_cast<size_t>(m_file.gcount());
+	}
+	if (m_file.bad()) {
+		throw DbWrapperException("Can't read the snapshot file");
+	}
+	return m_end >= n;
+}
+
+const unsigned char* SnapshotReader::take(size_t n)
+{
+	if (!fill(n)) {
+		throw DbWrapperException("The snapshot file is truncated");
+	}
+	const unsigned char* p = &m_buffer[m_begin];
+	m_begin += n;
+	return p;
+}
+
+uint64_t SnapshotReader::readLE(size_t bytes)
+{
+	const unsigned char* p = take(bytes);
+	uint64_t value = 0;
+	for (size_t i = bytes; i-- > 0;) {
+		value = (value << 8) | p[i];
+	}
+	return value;
+}
+
+uint64_t SnapshotReader::readCompactSize()
+{
+	unsigned char first = *take(1);
+	switch (first) {
+	case 253:
+		return readLE(2);
+	case 254:
+		return readLE(4);
+	case 255:
+		return readLE(8);
+	default:
+		return first;
+	}
+}
+
+/**
+ * Decode the Varint starting offset bytes past the read position without
+ * consuming it, returning its length in bytes.
+ * */
+size_t SnapshotReader::varintLength(size_t offset, uint64_t& value)
+{
+	value = 0;
+	for (size_t i = offset;; i++) {
+		if (!fill(i + 1)) {
+			throw DbWrapperException("The snapshot file is truncated");
+		}
+		if (value > (UINT64_MAX >> 7)) {
+			throw DbWrapperException("Malformed coin in the snapshot file");
+		}
+		unsigned char b = m_buffer[m_begin + i];
+		value = (value << 7) | (b & 0x7f);
+		if (!(b & 0x80)) {
+			return i + 1 - offset;
+		}
+		value++;
+	}
+}
+
+/**
+ * Cut the next coin out of the stream. Its length is not stored, it follows
+ * from the height code, the compressed amount and the script size Varints.
+ * */
+void SnapshotReader::readCoin(BytesVec& coin)
+{
+	uint64_t code, amount, scriptSize;
+	size_t length = varintLength(0, code);
+	length += varintLength(length, amount);
+	length += varintLength(length, scriptSize);
+	// Sizes 0 and 1 are hashes, 2 to 5 public keys, then the script length + 6
+	const uint64_t specialSizes[] = {20, 20, 32, 32, 32, 32};
+	uint64_t payload = scriptSize < 6 ? specialSizes[scriptSize] : scriptSize - 6;
+	if (payload > g_maxScriptSize) {
+		throw DbWrapperException("Malformed coin in the snapshot file");
+	}
+	length += static_cast<size_t>(payload);
+	const unsigned char* p = take(length);
+	coin.assign(p, p + length);
+}
+
+/**
+ * Visit every coin in file order, which is chainstate key order. Can only be
+ * called once per reader since the file is read sequentially.
+ * */
+void SnapshotReader::forEachUTXO(const CoinVisitor& visitor)
+{
+	BytesVec txid, coin;
+	uint64_t remaining = m_coinsCount;
+	while (remaining > 0) {
+		const unsigned char* p = take(32);
+		txid.assign(p, p + 32);
+		uint64_t coins = m_grouped ? readCompactSize() : 1;
+		if (coins == 0 || coins > remaining) {
+			throw DbWrapperException("Malformed coin count in the snapshot file");
+		}
+		for (uint64_t i = 0; i < coins; i++) {
+			uint64_t vout = m_grouped ? readCompactSize() : readLE(4);
+			if (vout > UINT32_MAX) {
+				throw DbWrapperException("Malformed output index in the snapshot file");
+			}
+			readCoin(coin);
+			Varint v(coin);
+			UTXO u(v);
+			visitor(txid, static_cast<uint32_t>(vout), u);
+		}
+		remaining -= coins;
+	}
+	if (fill(1)) {
+		throw DbWrapperException("The snapshot file has data after the last coin");
+	}
+}
+
+/**
+ * The snapshot counterpart of DBWrapper::dumpAllUTXOs, with the same output.
+ * */
+void SnapshotReader::dumpAllUTXOs(const std::filesystem::path& path, const DumpOptions& options,
+	UtxoCommitment* commitment)
+{
+	ShardedWriter writer(path, options.shards, options.format);
+	forEachUTXO([&](const BytesVec& internalTxid, uint32_t vout, UTXO& utxo) {
+		if (commitment) {
+			commitment->add(internalTxid, vout, utxo);
+		}
+		if (utxo.getAmount()) {
+			BytesVec txid = internalTxid;
+			utils::switchEndianness(txid);
+			utxo.setTXID(txid);
+			writer.write(options.shardKey == ShardKey::Txid ? txid : utxo.getPublicKey(), utxo);
+		}
+	});
+	writer.close();
+	if (commitment) {
+		commitment->finish();
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <filesystem>
+#include "DbWrapper.h"
+
+class UtxoCommitment;
+class UTXO;
+
+/**
+ * Reads the coins of a Bitcoin Core `dumptxoutset` (assumeutxo) snapshot
+ * file, as an alternative to scanning a chainstate with DBWrapper.
+ *
+ * The file is a header followed by every coin in chainstate key order, so it
+ * is read front to back in large blocks with no seeks. Both layouts Core has
+ * written are accepted:
+ *  - since v28: "utxo\xff", version, network magic, base block hash and coin
+ *    count, then per txid the txid, the number of its coins and for each the
+ *    CompactSize output index and the coin,
+ *  - before: base block hash and coin count, then per coin the txid, the
+ *    32 bit output index and the coin.
+ *
+ * A coin is serialized exactly as a de-obfuscated chainstate value, so each
+ * one is cut out of the stream and decoded by UTXO.
+ * */
+class SnapshotReader {
+public:
+	/** Called for every coin; txid is in internal byte order, as in chainstate keys. */
+	using CoinVisitor = std::function<void(const std::vector<unsigned char>& txid, uint32_t vout, UTXO& utxo)>;
+
+	explicit SnapshotReader(const std::filesystem::path& path);
+	void getBestBlockHash(std::string& hash) const;
+	uint64_t coinsCount() const {
+		return m_coinsCount;
+	}
+	void forEachUTXO(const CoinVisitor& visitor);
+	void dumpAllUTXOs(const std::filesystem::path& path, const DumpOptions& options = DumpOptions(),
+		UtxoCommitment* commitment = nullptr);
+
+private:
+	void readHeader();
+	bool fill(size_t n);
+	const unsigned char* take(size_t n);
+	uint64_t readLE(size_t bytes);
+	uint64_t readCompactSize();
+	size_t varintLength(size_t offset, uint64_t& value);
+	void readCoin(std::vector<unsigned char>& coin);
+
+private:
+	static const size_t m_readSize = 8 << 20;
+	std::ifstream m_file;
+	std::vector<unsigned char> m_buffer;
+	size_t m_begin = 0;
+	size_t m_end = 0;
+	bool m_grouped = false;
+	std::vector<unsigned char> m_baseBlockHash;
+	uint64_t m_coinsCount = 0;
+};
@@ -0,0 +1,120 @@
+#include "SqliteWriter.h"
+#include "Utxo.h"
+#include "DbWrapperException.h"
+
+#ifdef UTXOPARSER_WITH_SQLITE
+#include <sqlite3.h>
+
+SqliteWriter::SqliteWriter(const std::filesystem::path& path)
+{
+	// Start from an empty database like the other writers, so a rerun does not append to the rows already there
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+	if (ec) {
+		std::string errMsg("Can't replace the output file ");
+		errMsg += path.string();
+		throw DbWrapperException(errMsg.c_str());
+	}
+
+	try {
+		check(sqlite3_open(path.string().c_str(), &m_db), "Can't open the SQLite database");
+		exec("PRAGMA journal_mode = OFF");
+		exec("PRAGMA synchronous = OFF");
+		exec("PRAGMA locking_mode = EXCLUSIVE");
+		exec("PRAGMA cache_size = -262144");
+		exec("CREATE TABLE utxo (script BLOB NOT NULL, amount INTEGER NOT NULL, "
+			"height INTEGER NOT NULL, coinbase INTEGER NOT NULL)");
+		check(sqlite3_prepare_v2(m_db, "INSERT INTO utxo (script, amount, height, coinbase) VALUES (?, ?, ?, ?)",
+			-1, &m_insert, nullptr), "Can't prepare the SQLite insert");
+		exec("BEGIN");
+	} catch (...) {
+		// The destructor does not run for a constructor that throws
+		sqlite3_finalize(m_insert);
+		sqlite3_close(m_db);
+		throw;
+	}
+}
+
+SqliteWriter::~SqliteWriter()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void SqliteWriter::check(int rc, const char* what)
+{
+	if (rc != SQLITE_OK && rc != SQLITE_DONE && rc != SQLITE_ROW) {
+		std::string errMsg(what);
+		errMsg += ". ";
+		errMsg += m_db ? sqlite3_errmsg(m_db) : sqlite3_errstr(rc);
+		throw DbWrapperException(errMsg.c_str());
+	}
+}
+
+void SqliteWriter::exec(const char* sql)
+{
+	check(sqlite3_exec(m_db, sql, nullptr, nullptr, nullptr), sql);
+}
+
+void SqliteWriter::write(const UTXO& utxo)
+{
+	const auto& script = utxo.getPublicKey();
+	// A null pointer would bind NULL rather than an empty script
+	static const unsigned char empty = 0;
+	sqlite3_bind_blob(m_insert, 1, script.empty() ? &empty : script.data(), static_cast<int>(script.size()), SQLITE_STATIC);
+	sqlite3_bind_int64(m_insert, 2, static_cast<sqlite3_int64>(utxo.getAmount()));
+	sqlite3_bind_int64(m_insert, 3, static_cast<sqlite3_int64>(utxo.getHeight()));
+	sqlite3_bind_int(m_insert, 4, utxo.isCoinbase() ? 1 : 0);
+	check(sqlite3_step(m_insert), "Can't insert into the SQLite database");
+	sqlite3_reset(m_insert);
+
+	if (++m_rowsInTransaction == m_rowsPerTransaction) {
+		exec("COMMIT");
+		exec("BEGIN");
+		m_rowsInTransaction = 0;
+	}
+}
+
+void SqliteWriter::close()
+{
+	if (!m_db) {
+		return;
+	}
+	sqlite3_finalize(m_insert);
+	m_insert = nullptr;
+	int rc = sqlite3_exec(m_db, "COMMIT", nullptr, nullptr, nullptr);
+	sqlite3_close(m_db);
+	m_db = nullptr;
+	check(rc, "Can't commit to the SQLite database");
+}
+
+#else
+
+SqliteWriter::SqliteWriter(const std::filesystem::path&)
+{
+	throw DbWrapperException("SQLite output is not available: build with UTXOPARSER_WITH_SQLITE and link sqlite3");
+}
+
+SqliteWriter::~SqliteWriter()
+{
+}
+
+void SqliteWriter::write(const UTXO&)
+{
+}
+
+void SqliteWriter::close()
+{
+}
+
+void SqliteWriter::exec(const char*)
+{
+}
+
+void SqliteWriter::check(int, const char*)
+{
+}
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "RecordWriter.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/**
+ * Loads coins straight into an SQLite database through one prepared INSERT,
+ * committing every m_rowsPerTransaction rows. An existing file at the path is
+ * replaced, so journaling and fsync are off: an interrupted export is simply
+ * rerun from scratch.
+ *
+ * Each writer has a 256 MiB page cache, and each shard has its own writer, so
+ * --shards N can use up to N x 256 MiB.
+ *
+ * Rows go to the table
+ *
+ *     utxo (script BLOB, amount INTEGER, height INTEGER, coinbase INTEGER)
+ *
+ * Needs the build to define UTXOPARSER_WITH_SQLITE and link against sqlite3.
+ * Otherwise the constructor throws.
+ * */
+class SqliteWriter : public RecordWriter {
+public:
+	explicit SqliteWriter(const std::filesystem::path& path);
+	~SqliteWriter() override;
+	void write(const UTXO& utxo) override;
+	void close() override;
+
+private:
+	void exec(const char* sql);
+	void check(int rc, const char* what);
+
+private:
+	static const size_t m_rowsPerTransaction = 1000000;
+	sqlite3* m_db = nullptr;
+	sqlite3_stmt* m_insert = nullptr;
+	size_t m_rowsInTransaction = 0;
+};
@@ -1,4 +1,5 @@
 #include "Utxo.h"
+#include "PubKey.h"
 
 UTXO::UTXO(Varint<std::vector<unsigned char>>& inputValue)
 {
@@ -13,22 +14,11 @@ void UTXO::setHeight()
 	std::vector<unsigned char> first;
 	m_inputValue.decode(0, first);
 	// The first Varint in this context represents the block height and coinbase status.
-	// The final bit of the final byte in the decoded varint indicates coinbase status.
-	m_coinbase = first.back() & 1 ? true : false;
-	
-	// The bits preceding the least significant bit need to be shifted right to yield the block height.
-	// This is because the protocol reserves the least significant bit of this Varint as a boolean
-	// indicator of the coinbase status of this UTXO.
-	Varint<std::vector<unsigned char>>::shiftAllBytesRight(first, 1);
-
-	// Convert block height represented by first (a base 256 encoded vector of bytes) to a string 
-	// as an intermediate to avoid expensive math operations.
-	std::string blockHeight;
-	utils::bytesToDecimal(first, blockHeight);
-
-	// Convert to a uint64_t type
-	char* pEnd;
-	m_height = strtol(blockHeight.c_str(), &pEnd, 10);
+	// The protocol reserves the least significant bit of this Varint as a boolean
+	// indicator of the coinbase status of this UTXO; the bits preceding it are the height.
+	uint64_t code = utils::toUint64(first);
+	m_coinbase = (code & 1) ? true : false;
+	m_height = code >> 1;
 }
 
 void UTXO::setAmount()
@@ -39,15 +29,7 @@ void UTXO::setAmount()
 	// The decode() method returns the index of the following byte
 	m_scriptStart = m_inputValue.decode(1, rawAmount);
 
-	std::string amountDecimalStr;
-	
-	// Make a decimal string.
-	utils::bytesToDecimal(rawAmount, amountDecimalStr);
-
-	// Convert to a uint64_t type to allow for decompression and further numeric processing.
-	char* pEnd;
-	long int a = strtol(amountDecimalStr.c_str(), &pEnd, 10);
-	m_amount = DecompressAmount((uint64_t)a);
+	m_amount = DecompressAmount(utils::toUint64(rawAmount));
 }
 
 /**
@@ -62,14 +44,21 @@ void UTXO::setScriptPubKey()
 	// nSize is a Varint - nSize receives the decoded value
 	std::vector<unsigned char> nSize;
 
-	// scriptStart is the index of the first script byte
+	// scriptStart is the index of the first script byte, -1 if the script is empty
 	m_scriptStart = m_inputValue.decode(2, nSize);	
 	
 	// The script is comprised of the remaining bytes in the retrieved value
-	m_inputValue.remainingBytesFromIndex(m_scriptStart, in);
+	if (m_scriptStart >= 0) {
+		m_inputValue.remainingBytesFromIndex(m_scriptStart, in);
+	}
 	
 	// There are 6 special script types. Outside these 6, the entire script is present
-	m_scriptType = nSize[0] < 6 ? nSize[0] : 6;
+	uint64_t size = utils::toUint64(nSize);
+	m_scriptType = size < 6 ? static_cast<unsigned char>(size) : 6;
+	const size_t specialSizes[] = {20, 20, 32, 32, 32, 32};
+	if (m_scriptType < 6 && in.size() < specialSizes[m_scriptType]) {
+		return;
+	}
 
 	switch(m_scriptType) {
 	case 0x00: // P2PKH Pay to Public Key Hash
@@ -96,19 +85,45 @@ void UTXO::setScriptPubKey()
 		memcpy(&m_scriptPubKey[2], in.data(), 32);
 		m_scriptPubKey[34] = OP_CHECKSIG;
 		break;
-	case 0x04:// PKPK: upcoming data is an uncompressed public key
-	case 0x05:// PKPK: upcoming data is an uncompressed public key
+	case 0x04:// PKPK: upcoming data is an uncompressed public key, stored as its x coordinate [y=even]
+	case 0x05:// PKPK: upcoming data is an uncompressed public key, stored as its x coordinate [y=odd]
+	{
+		std::vector<unsigned char> pubKey;
+		if (!pubkey::decompress(in.data(), m_scriptType == 0x05, pubKey)) {
+			break;
+		}
+		m_scriptPubKey.resize(67);
+		m_scriptPubKey[0] = 65;
+		memcpy(&m_scriptPubKey[1], pubKey.data(), 65);
+		m_scriptPubKey[66] = OP_CHECKSIG;
 		break;
-	default: // Upcoming script is custom, made up of nSize bytes
+	}
+	default: // Upcoming script is custom, made up of nSize - 6 bytes
 		assert(m_scriptType == 6);
-		// Convert nSize (vector of bytes)
-		auto customScriptSize = static_cast<size_t>(utils::toUint64(nSize) - 6);
-		const int minimumScriptPubKeySize = 20;
-		if (customScriptSize > minimumScriptPubKeySize) {
-			m_scriptPubKey.resize(customScriptSize);
-			memcpy(&m_scriptPubKey[0], in.data() + 1, customScriptSize);
+		auto customScriptSize = static_cast<size_t>(size - 6);
+		if (customScriptSize <= in.size()) {
+			m_scriptPubKey.assign(in.begin(), in.begin() + customScriptSize);
 		}
+	}
+}
 
+// See function CompressAmount from Bitcoin Core `src/compressor.cpp`: https://github.com/bitcoin/bitcoin/blob/0.20/src/compressor.cpp#L149
+uint64_t UTXO::CompressAmount(uint64_t n)
+{
+	if (n == 0)
+		return 0;
+	int e = 0;
+	while (((n % 10) == 0) && e < 9) {
+		n /= 10;
+		e++;
+	}
+	if (e < 9) {
+		int d = (n % 10);
+		assert(d >= 1 && d <= 9);
+		n /= 10;
+		return 1 + (n*9 + d - 1)*10 + e;
+	} else {
+		return 1 + (n - 1)*10 + 9;
 	}
 }
 
@@ -139,6 +154,42 @@ uint64_t UTXO::DecompressAmount(uint64_t x)
 	return n;
 }
 
+/**
+ * The standard type of a scriptPubKey, from its exact shape. P2PK covers
+ * compressed (02/03) and uncompressed (04) keys.
+ * */
+ScriptType UTXO::classifyScript(const std::vector<unsigned char>& script)
+{
+	const size_t n = script.size();
+	const unsigned char* s = script.data();
+	if (n == 25 && s[0] == OP_DUP && s[1] == OP_HASH160 && s[2] == 20 && s[23] == OP_EQUALVERIFY && s[24] == OP_CHECKSIG) {
+		return ScriptType::P2PKH;
+	}
+	if (n == 23 && s[0] == OP_HASH160 && s[1] == 20 && s[22] == OP_EQUAL) {
+		return ScriptType::P2SH;
+	}
+	if ((n == 35 && s[0] == 33 && (s[1] == 0x02 || s[1] == 0x03) && s[34] == OP_CHECKSIG) ||
+		(n == 67 && s[0] == 65 && s[1] == 0x04 && s[66] == OP_CHECKSIG)) {
+		return ScriptType::P2PK;
+	}
+	if (n == 22 && s[0] == OP_0 && s[1] == 20) {
+		return ScriptType::P2WPKH;
+	}
+	if (n == 34 && s[0] == OP_0 && s[1] == 32) {
+		return ScriptType::P2WSH;
+	}
+	if (n == 34 && s[0] == OP_1 && s[1] == 32) {
+		return ScriptType::P2TR;
+	}
+	return ScriptType::Other;
+}
+
+const char* UTXO::scriptTypeName(ScriptType type)
+{
+	static const char* names[] = {"P2PKH", "P2SH", "P2PK", "P2WPKH", "P2WSH", "P2TR", "Other"};
+	return type < ScriptType::Count ? names[static_cast<size_t>(type)] : "Unknown";
+}
+
 void UTXO::scriptDescription(size_t type, std::string& desc)
 {
 	/** Map scriptType to string **/
@@ -178,4 +229,8 @@ const std::vector<unsigned char>& UTXO::getPublicKey() const {
 
 uint64_t UTXO::getAmount() const {
 	return m_amount;
+}
+
+bool UTXO::isCoinbase() const {
+	return m_coinbase;
 }
\ No newline at end of file
@@ -3,6 +3,18 @@
 #include <string>
 #include "Varint.h"
 
+/** The standard scriptPubKey types that reports break the UTXO set down by. */
+enum class ScriptType : unsigned char {
+	P2PKH,
+	P2SH,
+	P2PK,
+	P2WPKH,
+	P2WSH,
+	P2TR,
+	Other,
+	Count,
+};
+
 class UTXO {
 public:
 	UTXO(Varint<std::vector<unsigned char>>& inputValue);
@@ -13,10 +25,14 @@ public:
 		return m_height;
 	}
 	uint64_t getAmount() const;
+	bool isCoinbase() const;
     const std::vector<unsigned char>& getPublicKey() const;
+	static uint64_t CompressAmount(uint64_t n);
+	static uint64_t DecompressAmount(uint64_t x);
+	static ScriptType classifyScript(const std::vector<unsigned char>& script);
+	static const char* scriptTypeName(ScriptType type);
 
 private:	
-	uint64_t DecompressAmount(uint64_t x);
 	void setHeight();
 	void setAmount();
 	void setScriptPubKey();
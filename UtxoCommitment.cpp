@@ -0,0 +1,182 @@
+#include <fstream>
+#include <iomanip>
+#include "UtxoCommitment.h"
+#include "DbWrapperException.h"
+#include "utils.h"
+
+namespace {
+void appendLE(std::string& s, uint64_t v, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; i++) {
+		s.push_back((char)(v >> (8 * i)));
+	}
+}
+
+/** Bitcoin's CompactSize length prefix. */
+void appendCompactSize(std::string& s, uint64_t n)
+{
+	if (n < 253) {
+		appendLE(s, n, 1);
+	} else if (n <= 0xFFFF) {
+		s.push_back((char)253);
+		appendLE(s, n, 2);
+	} else if (n <= 0xFFFFFFFF) {
+		s.push_back((char)254);
+		appendLE(s, n, 4);
+	} else {
+		s.push_back((char)255);
+		appendLE(s, n, 8);
+	}
+}
+
+/** uint256 hashes are displayed byte-reversed. */
+std::string hashToHex(unsigned char (&hash)[32])
+{
+	std::vector<unsigned char> bytes(hash, hash + 32);
+	utils::switchEndianness(bytes);
+	std::string hex;
+	utils::bytesToHexstring(bytes, hex);
+	return hex;
+}
+}
+
+UtxoCommitment::UtxoCommitment(size_t threads)
+{
+	if (threads == 0) {
+		threads = 1;
+	}
+	m_accumulators.resize(threads);
+	for (size_t i = 0; i < threads; i++) {
+		m_workers.emplace_back(&UtxoCommitment::worker, this, i);
+	}
+}
+
+UtxoCommitment::~UtxoCommitment()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done = true;
+	}
+	m_queueNotEmpty.notify_all();
+	for (auto& t : m_workers) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+}
+
+/**
+ * Serialize the coin the way Core's TxOutSer does: outpoint (txid, vout),
+ * height * 2 + coinbase as uint32, then the output (amount, script).
+ * See: https://github.com/bitcoin/bitcoin/blob/v26.0/src/kernel/coinstats.cpp#L56
+ *
+ * txid is in its internal byte order, as it appears in the chainstate key.
+ * */
+void UtxoCommitment::add(const std::vector<unsigned char>& txid, uint32_t vout, const UTXO& utxo)
+{
+	const auto& script = utxo.getPublicKey();
+	m_serialized.assign(txid.begin(), txid.end());
+	appendLE(m_serialized, vout, 4);
+	appendLE(m_serialized, (utxo.getHeight() << 1) + (utxo.isCoinbase() ? 1 : 0), 4);
+	appendLE(m_serialized, utxo.getAmount(), 8);
+	appendCompactSize(m_serialized, script.size());
+	m_serialized.append(script.begin(), script.end());
+
+	m_hasher.write(reinterpret_cast<const unsigned char*>(m_serialized.data()), m_serialized.size());
+	m_batch.data += m_serialized;
+	m_batch.ends.push_back(m_batch.data.size());
+	if (m_batch.ends.size() == m_batchSize) {
+		submit();
+	}
+
+	m_coins++;
+	m_totalAmount += utxo.getAmount();
+}
+
+void UtxoCommitment::submit()
+{
+	if (m_batch.ends.empty()) {
+		return;
+	}
+	{
+		// Bound the queue so a slow hash does not buffer the whole UTXO set.
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_queueNotFull.wait(lock, [this] { return m_queue.size() < 2 * m_workers.size(); });
+		m_queue.push_back(std::move(m_batch));
+	}
+	m_queueNotEmpty.notify_one();
+	m_batch = Batch();
+}
+
+void UtxoCommitment::worker(size_t index)
+{
+	MuHash3072& accumulator = m_accumulators[index];
+	for (;;) {
+		Batch batch;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_queueNotEmpty.wait(lock, [this] { return m_done || !m_queue.empty(); });
+			if (m_queue.empty()) {
+				return;
+			}
+			batch = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+		m_queueNotFull.notify_one();
+
+		size_t start = 0;
+		for (auto end : batch.ends) {
+			accumulator.insert(reinterpret_cast<const unsigned char*>(batch.data.data()) + start, end - start);
+			start = end;
+		}
+	}
+}
+
+void UtxoCommitment::finish()
+{
+	submit();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done = true;
+	}
+	m_queueNotEmpty.notify_all();
+	for (auto& t : m_workers) {
+		t.join();
+	}
+
+	MuHash3072 muHash;
+	for (const auto& accumulator : m_accumulators) {
+		muHash *= accumulator;
+	}
+
+	unsigned char hash[32];
+	muHash.finalize(hash);
+	m_muHash = hashToHex(hash);
+
+	// hash_serialized_3 is double SHA256
+	m_hasher.finalize(hash);
+	Sha256().write(hash, sizeof(hash)).finalize(hash);
+	m_hashSerialized = hashToHex(hash);
+}
+
+/**
+ * Write the result with the field names of `gettxoutsetinfo`, so it can be
+ * compared against the node directly.
+ * */
+void UtxoCommitment::writeStats(const std::filesystem::path& path, const std::string& bestBlock) const
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::string errMsg("Can't create the stats file ");
+		errMsg += path.string();
+		throw DbWrapperException(errMsg.c_str());
+	}
+	file << "{\n"
+	     << "  \"bestblock\": \"" << bestBlock << "\",\n"
+	     << "  \"txouts\": " << m_coins << ",\n"
+	     << "  \"total_amount\": " << m_totalAmount / 100000000 << "."
+	     << std::setw(8) << std::setfill('0') << m_totalAmount % 100000000 << ",\n"
+	     << "  \"hash_serialized_3\": \"" << m_hashSerialized << "\",\n"
+	     << "  \"muhash\": \"" << m_muHash << "\"\n"
+	     << "}\n";
+}
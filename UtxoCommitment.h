@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include "Sha256.h"
+#include "MuHash3072.h"
+#include "Utxo.h"
+
+/**
+ * Computes Bitcoin Core's UTXO set commitments, `hash_serialized_3` and
+ * `muhash`, as reported by `gettxoutsetinfo`, over the coins fed to add().
+ *
+ * Coins must be added in chainstate key order, since hash_serialized_3 is a
+ * plain SHA256d over the serialized coins and is computed inline. MuHash is
+ * order independent: coins are handed to worker threads in batches, each
+ * worker keeps its own accumulator and the accumulators are multiplied
+ * together in finish().
+ * */
+class UtxoCommitment {
+public:
+	explicit UtxoCommitment(size_t threads = std::thread::hardware_concurrency());
+	~UtxoCommitment();
+	void add(const std::vector<unsigned char>& txid, uint32_t vout, const UTXO& utxo);
+	void finish();
+	void writeStats(const std::filesystem::path& path, const std::string& bestBlock) const;
+	const std::string& hashSerialized() const {
+		return m_hashSerialized;
+	}
+	const std::string& muHash() const {
+		return m_muHash;
+	}
+	uint64_t coins() const {
+		return m_coins;
+	}
+	uint64_t totalAmount() const {
+		return m_totalAmount;
+	}
+
+private:
+	struct Batch {
+		std::string data;
+		std::vector<size_t> ends;
+	};
+	void worker(size_t index);
+	void submit();
+
+private:
+	static const size_t m_batchSize = 4096;
+	Sha256 m_hasher;
+	Batch m_batch;
+	std::string m_serialized;
+	std::deque<Batch> m_queue;
+	std::mutex m_mutex;
+	std::condition_variable m_queueNotEmpty;
+	std::condition_variable m_queueNotFull;
+	bool m_done = false;
+	std::vector<std::thread> m_workers;
+	std::vector<MuHash3072> m_accumulators;
+	uint64_t m_coins = 0;
+	uint64_t m_totalAmount = 0;
+	std::string m_hashSerialized;
+	std::string m_muHash;
+};
@@ -0,0 +1,281 @@
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <stdexcept>
+#include "UtxoEstimator.h"
+#include "DbWrapper.h"
+#include "DbWrapperException.h"
+#include "Utxo.h"
+
+namespace {
+const uint64_t g_bucketSpan = uint64_t(1) << 56;
+const size_t g_pilotSeeks = 32;
+const size_t g_pilotCoins = 64;
+// Coins a sample window is sized to hold on average
+const double g_coinsPerWindow = 32;
+// Two sided 95% quantile of the normal distribution
+const double g_z95 = 1.959964;
+
+/** The first 8 txid bytes of a coin key as a position in the txid space. */
+uint64_t keyPosition(const leveldb::Slice& key)
+{
+	uint64_t position = 0;
+	for (size_t i = 1; i < 9; i++) {
+		position = (position << 8) | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0);
+	}
+	return position;
+}
+
+std::string positionKey(uint64_t position)
+{
+	std::string key(1, 'C');
+	for (int shift = 56; shift >= 0; shift -= 8) {
+		key.push_back(static_cast<char>(position >> shift));
+	}
+	return key;
+}
+
+/** The key at offset within a bucket; the end of the last bucket is the end of the coins. */
+std::string bucketKey(size_t bucket, uint64_t offset)
+{
+	if (offset == g_bucketSpan) {
+		return bucket + 1 == UtxoEstimator::g_buckets ? std::string(1, 'D') : positionKey((bucket + 1) * g_bucketSpan);
+	}
+	return positionKey(bucket * g_bucketSpan + offset);
+}
+}
+
+UtxoEstimator::UtxoEstimator(size_t samples, size_t threads)
+	: m_samples(samples), m_threads(threads == 0 ? 1 : threads)
+{
+	if (m_samples < g_minSamples) {
+		throw std::invalid_argument{"The estimate needs at least two samples per bucket"};
+	}
+}
+
+/**
+ * Width of the txid space window expected to hold g_coinsPerWindow coins,
+ * from the gaps after a few random seeks. 0 if the set is empty.
+ * */
+double UtxoEstimator::pilotWindow(DBWrapper& db) const
+{
+	std::mt19937_64 rng(std::random_device{}());
+	double coins = 0, span = 0;
+	for (size_t i = 0; i < g_pilotSeeks; i++) {
+		uint64_t start = rng();
+		size_t read = 0;
+		uint64_t last = start;
+		db.scanUTXOs(positionKey(start), std::string(1, 'D'), [&](const leveldb::Slice& key, const UTXO&) {
+			last = keyPosition(key);
+			return ++read < g_pilotCoins;
+		});
+		if (read == g_pilotCoins) {
+			// The gap up to the last coin read holds the coins before it
+			coins += read - 1;
+			span += static_cast<double>(last - start);
+		} else {
+			coins += read;
+			span += std::ldexp(1.0, 64) - static_cast<double>(start);
+		}
+	}
+	if (coins == 0) {
+		return 0;
+	}
+	return g_coinsPerWindow * span / coins;
+}
+
+/**
+ * Draw the samples of one bucket. Each sample holds the totals of a window
+ * scaled up to the whole bucket.
+ * */
+void UtxoEstimator::sampleBucket(DBWrapper& db, size_t bucket, double window, uint64_t seed)
+{
+	std::mt19937_64 rng(seed);
+	const uint64_t width = window >= static_cast<double>(g_bucketSpan) ? g_bucketSpan
+		: std::max<uint64_t>(1, static_cast<uint64_t>(window));
+	const double scale = static_cast<double>(g_bucketSpan) / static_cast<double>(width);
+	std::uniform_int_distribution<uint64_t> offsets(0, g_bucketSpan - 1);
+
+	auto& samples = m_bucketSamples[bucket];
+	samples.assign(m_allocation[bucket], Measures());
+	for (auto& sample : samples) {
+		size_t coins = 0;
+		auto visit = [&sample, &coins](const leveldb::Slice&, const UTXO& utxo) {
+			double amount = static_cast<double>(utxo.getAmount());
+			size_t type = static_cast<size_t>(UTXO::classifyScript(utxo.getPublicKey()));
+			sample[0] += 1;
+			sample[1] += amount;
+			sample[2 + 2 * type] += 1;
+			sample[3 + 2 * type] += amount;
+			coins++;
+			return true;
+		};
+
+		uint64_t offset = width == g_bucketSpan ? 0 : offsets(rng);
+		if (g_bucketSpan - offset >= width) {
+			db.scanUTXOs(bucketKey(bucket, offset), bucketKey(bucket, offset + width), visit);
+		} else {
+			// Wrap around to the start of the bucket
+			db.scanUTXOs(bucketKey(bucket, offset), bucketKey(bucket, g_bucketSpan), visit);
+			db.scanUTXOs(bucketKey(bucket, 0), bucketKey(bucket, width - (g_bucketSpan - offset)), visit);
+		}
+		for (auto& measure : sample) {
+			measure *= scale;
+		}
+		m_coinsRead += coins;
+	}
+}
+
+void UtxoEstimator::run(DBWrapper& db)
+{
+	m_bucketSamples.assign(g_buckets, {});
+	m_coinsRead = 0;
+	double window = pilotWindow(db);
+	if (window == 0) {
+		return;
+	}
+
+	// Spread the samples over the buckets by their approximate size
+	std::vector<std::pair<std::string, std::string>> ranges;
+	for (size_t bucket = 0; bucket < g_buckets; bucket++) {
+		ranges.emplace_back(bucketKey(bucket, 0), bucketKey(bucket, g_bucketSpan));
+	}
+	std::vector<uint64_t> sizes;
+	db.approximateSizes(ranges, sizes);
+	double totalSize = 0;
+	for (auto size : sizes) {
+		totalSize += static_cast<double>(size);
+	}
+	m_allocation.assign(g_buckets, 0);
+	for (size_t bucket = 0; bucket < g_buckets; bucket++) {
+		double share = totalSize > 0 ? sizes[bucket] / totalSize : 1.0 / g_buckets;
+		m_allocation[bucket] = std::max<size_t>(2, static_cast<size_t>(std::llround(share * m_samples)));
+		if (window >= static_cast<double>(g_bucketSpan)) {
+			// A window covers the whole bucket, one exact count is enough
+			m_allocation[bucket] = 1;
+		}
+	}
+
+	std::vector<std::thread> threads;
+	std::vector<std::exception_ptr> errors(m_threads);
+	const uint64_t seed = std::random_device{}();
+	for (size_t t = 0; t < m_threads; t++) {
+		threads.emplace_back([this, t, &db, window, seed, &errors] {
+			try {
+				for (size_t bucket = t; bucket < g_buckets; bucket += m_threads) {
+					sampleBucket(db, bucket, window, seed + bucket);
+				}
+			} catch (...) {
+				errors[t] = std::current_exception();
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	for (auto& e : errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
+}
+
+/**
+ * Stratified estimate of the total of a measure: the sum of the bucket
+ * means, with the variance of each mean estimated from its samples.
+ * */
+UtxoEstimator::Estimate UtxoEstimator::total(size_t measure) const
+{
+	double sum = 0, variance = 0;
+	for (const auto& samples : m_bucketSamples) {
+		const size_t n = samples.size();
+		if (n == 0) {
+			continue;
+		}
+		double mean = 0;
+		for (const auto& sample : samples) {
+			mean += sample[measure];
+		}
+		mean /= n;
+		sum += mean;
+		if (n > 1) {
+			double squares = 0;
+			for (const auto& sample : samples) {
+				squares += (sample[measure] - mean) * (sample[measure] - mean);
+			}
+			variance += squares / (n - 1) / n;
+		}
+	}
+	return {sum, g_z95 * std::sqrt(variance)};
+}
+
+/**
+ * Ratio estimate of total(measure) / total(base), with the linearized
+ * variance of the residuals measure - ratio * base.
+ * */
+UtxoEstimator::Estimate UtxoEstimator::ratio(size_t measure, size_t base) const
+{
+	double denominator = total(base).value;
+	if (denominator == 0) {
+		return {0, 0};
+	}
+	double r = total(measure).value / denominator;
+	double variance = 0;
+	for (const auto& samples : m_bucketSamples) {
+		const size_t n = samples.size();
+		if (n < 2) {
+			continue;
+		}
+		double mean = 0;
+		for (const auto& sample : samples) {
+			mean += sample[measure] - r * sample[base];
+		}
+		mean /= n;
+		double squares = 0;
+		for (const auto& sample : samples) {
+			double d = sample[measure] - r * sample[base] - mean;
+			squares += d * d;
+		}
+		variance += squares / (n - 1) / n;
+	}
+	return {r, g_z95 * std::sqrt(variance) / denominator};
+}
+
+/**
+ * Written as "metric,estimate,ci95_low,ci95_high" rows: the coin count and
+ * total amount in satoshis, then the share of the coins and of the amount
+ * held by each script type.
+ * */
+void UtxoEstimator::write(const std::filesystem::path& path) const
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::string errMsg("Can't create the output file ");
+		errMsg += path.string();
+		throw DbWrapperException(errMsg.c_str());
+	}
+
+	size_t samples = 0;
+	for (const auto& bucketSamples : m_bucketSamples) {
+		samples += bucketSamples.size();
+	}
+	file << "# UTXO set estimate from " << m_coinsRead << " coins in " << samples << " samples, 95% intervals\n";
+	file << "metric,estimate,ci95_low,ci95_high\n";
+	auto row = [&file](const std::string& metric, const Estimate& e, int precision) {
+		file << metric << std::fixed << std::setprecision(precision) << "," << e.value << ","
+			<< std::max(0.0, e.value - e.halfWidth) << "," << e.value + e.halfWidth << "\n";
+	};
+	row("coins", total(0), 0);
+	row("amount", total(1), 0);
+	const size_t types = static_cast<size_t>(ScriptType::Count);
+	for (size_t type = 0; type < types; type++) {
+		row(std::string("coins_share_") + UTXO::scriptTypeName(static_cast<ScriptType>(type)), ratio(2 + 2 * type, 0), 6);
+	}
+	for (size_t type = 0; type < types; type++) {
+		row(std::string("amount_share_") + UTXO::scriptTypeName(static_cast<ScriptType>(type)), ratio(3 + 2 * type, 1), 6);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include "Utxo.h"
+
+class DBWrapper;
+
+/**
+ * Estimates the coin count, total value and script type mix of the UTXO set
+ * from a random sample, in seconds instead of a full scan.
+ *
+ * The 'C' keyspace is split into 256 buckets by the first txid byte, and the
+ * samples are spread over them in proportion to their approximate size on
+ * disk. Each sample is a short scan over a window of the txid space, starting
+ * at a uniformly random point of its bucket and wrapping around inside it.
+ * The window is sized from a pilot pass to hold a few dozen coins.
+ *
+ * Since txids are uniformly distributed, the coins in a window scaled by
+ * bucket span / window width is an unbiased estimate of the bucket total.
+ * Bucket estimates are summed as a stratified sample; the shares of each
+ * script type are ratio estimates. Intervals are 95% normal intervals.
+ * */
+class UtxoEstimator {
+public:
+	static constexpr size_t g_buckets = 256;
+	/** At least two samples per bucket, so each bucket has a variance estimate. */
+	static constexpr size_t g_minSamples = 2 * g_buckets;
+
+	UtxoEstimator(size_t samples, size_t threads);
+	void run(DBWrapper& db);
+	void write(const std::filesystem::path& path) const;
+
+private:
+	// coins, amount, then coins and amount of every script type
+	static const size_t g_measures = 2 + 2 * static_cast<size_t>(ScriptType::Count);
+	using Measures = std::array<double, g_measures>;
+
+	struct Estimate {
+		double value;
+		double halfWidth;
+	};
+
+	double pilotWindow(DBWrapper& db) const;
+	void sampleBucket(DBWrapper& db, size_t bucket, double window, uint64_t seed);
+	Estimate total(size_t measure) const;
+	Estimate ratio(size_t measure, size_t base) const;
+
+private:
+	size_t m_samples;
+	size_t m_threads;
+	std::vector<size_t> m_allocation;
+	std::vector<std::vector<Measures>> m_bucketSamples;
+	std::atomic<size_t> m_coinsRead{0};
+};
@@ -1,6 +1,5 @@
 #include "Varint.h"
 
-static const int g_maxBits = 8;
 template <class T>
 Varint<T>::Varint() {
 	m_startIndexes = {};
@@ -11,7 +10,6 @@ template <class T>
 Varint<T>::Varint(T input) : inputBytes(input)
 {
 	setStartIndexes();
-	processBytes();
 }
 
 template <class T>
@@ -56,87 +54,24 @@ int Varint<T>::decode(size_t start, std::vector<unsigned char>& result)
 	base128To256(tmp, result);
 
 	size_t finalIndex = m_startIndexes[start] + nBytes;
-	return finalIndex < inputBytes.size() - 1 ? (int)finalIndex : -1;
+	return finalIndex < inputBytes.size() ? (int)finalIndex : -1;
 }
 
 template <class T>
 void Varint<T>::base128To256(const T& b128, T& b256)
 {
-	size_t nBytes = b128.size();
-	unsigned char current = 0, carry = 0;
-	for (const auto& b : b128) {
-		size_t offset = nBytes - 1;
-		// Set least significant bits in current, then shift into correct position 
-		current = (b & (0xFF << offset)) >> offset;
-		// Most significant bits are the last iterations carry
-		current |= carry;
-		b256.push_back(current);
-		
-		// Set carry bits and shift into correct position for next iteration.
-		carry = b & ~(0xFF << offset); // nBytes == 3, mask is 0000 0011
-		carry <<= (g_maxBits - offset);
-		nBytes--;
-	}
-}
-	
-template <class T>
-void Varint<T>::processBytes()
-{
-	std::vector<unsigned char> tmp;
-	tmp.reserve(inputBytes.size());
-	size_t nBytes = 0;
-	for (const auto& el : inputBytes) {
-		nBytes++;
-		// Most significant bit set zero denotes last byte
-		if (el <= 0x7F) {
-//		if ((el & (1 << 7)) == 0) {
-			tmp.push_back(el & (0xff >> 1));
-			break;
+	// Every byte but the last carries a +1 offset, so a digit can be 128 and does not fit
+	// in 7 bits. Accumulate the digits arithmetically into a big-endian base 256 number of
+	// the same length instead of packing their bits.
+	b256.assign(b128.size(), 0);
+	for (const auto& digit : b128) {
+		unsigned int carry = digit;
+		for (size_t i = b256.size(); i-- > 0;) {
+			carry += b256[i] * 128u;
+			b256[i] = carry & 0xFF;
+			carry >>= 8;
 		}
-		// For all bytes except the last, save the last 7 bits + 1
-		tmp.push_back((el & (0xff >> 1)) + 1);
-	}
-
-	unsigned char current = 0, carry = 0;
-	for (const auto& b : tmp) {
-		size_t offset = nBytes - 1;
-		// Set least significant bits in current, then shift into correct position 
-		current = (b & (0xFF << offset)) >> offset;
-		// Most significant bits are the last iterations carry
-		current |= carry;
-		m_result.push_back(current);
-		
-		// Set carry bits and shift into correct position for next iteration.
-		carry = b & ~(0xFF << offset); // nBytes == 3, mask is 0000 0011
-		carry <<= (g_maxBits - offset);
-		nBytes--;
 	}
-	shiftAllBytesRight(1);
 }
 
-template <class T>
-void Varint<T>::outputResult()
-{
-	for (const auto& el : m_result) {
-		std::cout << (int) el << " ";
-	}
-	std::cout << "\n";
-}
-
-template <class T>
-void Varint<T>::shiftAllBytesRight(size_t shift)
-{
-	for (auto& byte : m_result) {
-		byte >>= shift;
-	}
-}	
-
-template <class T>
-void Varint<T>::shiftAllBytesRight(T& bytes, size_t shift)
-{
-	for (auto& byte : bytes) {
-		byte >>= shift;
-	}
-}	
-
 template class Varint<std::vector<unsigned char>>;
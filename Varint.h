@@ -13,21 +13,16 @@ public:
 	Varint(T inputCollection);
 	Varint();
 	void getInputBytes(std::vector<unsigned char>& v);
-	void outputResult();
 	int decode(size_t start, std::vector<unsigned char>& result);
 	void remainingBytesFromIndex(size_t start, std::vector<unsigned char>& result);
-	void shiftAllBytesRight(size_t shift);
-	void static shiftAllBytesRight(T& bytes, size_t shift);
 
 private:
     void setStartIndexes();
-	void processBytes();
 	void base128To256(const T& b128, T& b256);
 
 private:
 	T inputBytes;
 	std::vector<size_t> m_startIndexes;
-	std::vector<unsigned char> m_result;
 };
 
 /** Script opcodes */
@@ -1,13 +1,53 @@
 #include <string>
 #include <filesystem>
+#include <thread>
+#include <fstream>
 #include "dbwrapper.h"
+#include "UtxoCommitment.h"
+#include "BalanceReport.h"
+#include "ResidentUtxoSet.h"
+#include "UtxoEstimator.h"
+#include "SnapshotReader.h"
+#include "DbWrapperException.h"
 namespace fs = std::filesystem;
 
 void ShowUsage(const std::string& name)
 {
-    std::cerr << "Usage: " << name << " db_path output_file_path\n"
-	      << "db_path is the path to the chainstate folder \n"
-		  << "output_file_path is the path to the file that will be created by the app with all balances " << std::endl;
+    std::cerr << "Usage: " << name << " db_path output_file_path [options]\n"
+	      << "db_path is the path to the chainstate folder, or to a dumptxoutset file with --snapshot \n"
+		  << "output_file_path is the path to the file that will be created by the app with all balances \n"
+		  << "Options:\n"
+		  << "  --shards N           split the output into N files, output.0.csv ... output.(N-1).csv \n"
+		  << "  --shard-key KEY      field hashed to pick a coin's shard: script (default) or txid \n"
+		  << "  --format FORMAT      csv (default, script hex and amount), pgcopy (PostgreSQL binary COPY \n"
+#ifdef UTXOPARSER_WITH_SQLITE
+		  << "                       of script, amount, height, coinbase) or sqlite (utxo table, up to \n"
+		  << "                       256 MiB of page cache per shard) \n"
+#else
+		  << "                       of script, amount, height, coinbase) \n"
+#endif
+		  << "  --stats FILE         write the coin count, total amount, best block and the UTXO set \n"
+		  << "                       commitments hash_serialized_3 and muhash (as gettxoutsetinfo) to FILE \n"
+		  << "  --top K              instead of exporting, write the K scripts with the largest balance \n"
+		  << "  --quantiles          instead of exporting, write quantiles of the UTXO values \n"
+		  << "                       (--top and --quantiles are approximate and can be combined) \n"
+		  << "  --resident           instead of exporting, load the set into memory and answer queries \n"
+		  << "                       read from stdin; answers go to output_file_path, - for stdout \n"
+		  << "  --estimate           instead of exporting, estimate from a random sample the coin count, \n"
+		  << "                       total amount and each script type's share of coins and amount; \n"
+		  << "                       rows are metric,estimate,ci95_low,ci95_high \n"
+		  << "  --samples N          number of sample windows for --estimate, about 32 coins each \n"
+		  << "                       (default 4096, at least 512) \n"
+		  << "  --snapshot           db_path is a Bitcoin Core dumptxoutset (assumeutxo) snapshot file; \n"
+		  << "                       only exporting and --stats work with it, not --top, --quantiles, \n"
+		  << "                       --resident or --estimate \n"
+		  << "LevelDB options (not with --snapshot):\n"
+		  << "  --cold-scan          profile for a full scan of a chainstate that is not in the page cache: \n"
+		  << "                       no block caching, table files read ahead in key order (256 MiB) \n"
+		  << "  --prefetch MB        read ahead MB of upcoming table files during the export scan \n"
+		  << "  --block-cache MB     size of the LevelDB block cache \n"
+		  << "  --max-open-files N   number of table files LevelDB keeps open \n"
+		  << "  --no-checksums       skip block checksum verification " << std::endl;
 }
 
 int main(int argc, char* argv[])
@@ -19,10 +59,168 @@ int main(int argc, char* argv[])
 
 	fs::path dbPath = argv[1];
 	fs::path outputPath = argv[2];
+	DumpOptions options;
+	fs::path statsPath;
+	size_t topK = 0;
+	bool quantiles = false;
+	bool resident = false;
+	bool estimate = false;
+	bool snapshot = false;
+	size_t samples = 4096;
+	ScanProfile profile;
+	bool exportOptions = false;
+	bool levelDbOptions = false;
+
+	for (int i = 3; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--shards" && i + 1 < argc) {
+			exportOptions = true;
+			char* pEnd;
+			options.shards = strtoul(argv[++i], &pEnd, 10);
+			if (*pEnd != '\0' || options.shards == 0) {
+				std::cerr << "--shards expects a positive number" << std::endl;
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--shard-key" && i + 1 < argc) {
+			exportOptions = true;
+			std::string key = argv[++i];
+			if (key == "script") {
+				options.shardKey = ShardKey::ScriptPubKey;
+			} else if (key == "txid") {
+				options.shardKey = ShardKey::Txid;
+			} else {
+				std::cerr << "--shard-key expects script or txid" << std::endl;
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--format" && i + 1 < argc) {
+			exportOptions = true;
+			std::string format = argv[++i];
+			if (format == "csv") {
+				options.format = OutputFormat::Csv;
+			} else if (format == "pgcopy") {
+				options.format = OutputFormat::PgCopy;
+			} else if (format == "sqlite") {
+				options.format = OutputFormat::Sqlite;
+			} else {
+				std::cerr << "--format expects csv, pgcopy or sqlite" << std::endl;
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--stats" && i + 1 < argc) {
+			exportOptions = true;
+			statsPath = argv[++i];
+		} else if (arg == "--top" && i + 1 < argc) {
+			char* pEnd;
+			topK = strtoul(argv[++i], &pEnd, 10);
+			if (*pEnd != '\0' || topK == 0) {
+				std::cerr << "--top expects a positive number" << std::endl;
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--quantiles") {
+			quantiles = true;
+		} else if (arg == "--resident") {
+			resident = true;
+		} else if (arg == "--snapshot") {
+			snapshot = true;
+		} else if (arg == "--estimate") {
+			estimate = true;
+		} else if (arg == "--samples" && i + 1 < argc) {
+			char* pEnd;
+			samples = strtoul(argv[++i], &pEnd, 10);
+			if (*pEnd != '\0' || samples < UtxoEstimator::g_minSamples) {
+				std::cerr << "--samples expects a number of at least " << UtxoEstimator::g_minSamples << std::endl;
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--cold-scan") {
+			levelDbOptions = true;
+			ScanProfile coldScan = ScanProfile::coldScan();
+			profile.fillCache = coldScan.fillCache;
+			if (!profile.prefetchWindow) {
+				profile.prefetchWindow = coldScan.prefetchWindow;
+			}
+		} else if (arg == "--no-checksums") {
+			levelDbOptions = true;
+			profile.verifyChecksums = false;
+		} else if ((arg == "--prefetch" || arg == "--block-cache" || arg == "--max-open-files") && i + 1 < argc) {
+			char* pEnd;
+			unsigned long value = strtoul(argv[++i], &pEnd, 10);
+			if (*pEnd != '\0') {
+				std::cerr << arg << " expects a number" << std::endl;
+				return EXIT_FAILURE;
+			}
+			levelDbOptions = true;
+			if (arg == "--prefetch") {
+				profile.prefetchWindow = static_cast<uint64_t>(value) << 20;
+			} else if (arg == "--block-cache") {
+				profile.blockCacheSize = static_cast<size_t>(value) << 20;
+			} else {
+				profile.maxOpenFiles = static_cast<int>(value);
+			}
+		} else {
+			ShowUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (snapshot && (resident || estimate || topK || quantiles)) {
+		std::cerr << "--snapshot only supports exporting and --stats" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if ((resident || estimate || topK || quantiles) && exportOptions) {
+		std::cerr << "--shards, --shard-key, --format and --stats only apply to exporting" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (snapshot && levelDbOptions) {
+		std::cerr << "The LevelDB options don't apply to --snapshot" << std::endl;
+		return EXIT_FAILURE;
+	}
 
 	try {
-		DBWrapper db(dbPath);
-		db.dumpAllUTXOs(outputPath);
+		if (snapshot) {
+			SnapshotReader reader(dbPath);
+			if (statsPath.empty()) {
+				reader.dumpAllUTXOs(outputPath, options);
+			} else {
+				UtxoCommitment commitment;
+				reader.dumpAllUTXOs(outputPath, options, &commitment);
+				std::string bestBlock;
+				reader.getBestBlockHash(bestBlock);
+				commitment.writeStats(statsPath, bestBlock);
+			}
+			return EXIT_SUCCESS;
+		}
+
+		DBWrapper db(dbPath, profile);
+		if (resident) {
+			// Open the answers file before the load, which takes minutes
+			std::ofstream file;
+			if (outputPath != "-") {
+				file.open(outputPath);
+				if (!file) {
+					std::string errMsg("Can't create the output file ");
+					errMsg += outputPath.string();
+					throw DbWrapperException(errMsg.c_str());
+				}
+			}
+			ResidentUtxoSet set(db, std::thread::hardware_concurrency());
+			set.load();
+			set.serve(std::cin, outputPath == "-" ? std::cout : file);
+		} else if (estimate) {
+			UtxoEstimator estimator(samples, std::thread::hardware_concurrency());
+			estimator.run(db);
+			estimator.write(outputPath);
+		} else if (topK || quantiles) {
+			BalanceReport report(topK, quantiles, std::thread::hardware_concurrency());
+			report.run(db);
+			report.write(outputPath);
+		} else if (statsPath.empty()) {
+			db.dumpAllUTXOs(outputPath, options);
+		} else {
+			UtxoCommitment commitment;
+			db.dumpAllUTXOs(outputPath, options, &commitment);
+			std::string bestBlock;
+			db.getBestBlockHash(bestBlock);
+			commitment.writeStats(statsPath, bestBlock);
+		}
 	} catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
 		return EXIT_FAILURE;
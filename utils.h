@@ -103,6 +103,29 @@ inline void bytesToDecimal(const std::vector<unsigned char>& bytes, std::string&
 	result = ss.str();
 }
 
+/**
+ * Append n in Bitcoin's VARINT encoding: base 128, most significant digit
+ * first, with the high bit set and one subtracted on every byte but the last.
+ *
+ * Used to build LevelDB keys, which end in the Varint of the output index.
+ * */
+inline void appendVarint(uint64_t n, std::string& out)
+{
+	unsigned char tmp[10];
+	size_t len = 0;
+	for (;;) {
+		tmp[len] = (n & 0x7F) | (len ? 0x80 : 0x00);
+		if (n <= 0x7F) {
+			break;
+		}
+		n = (n >> 7) - 1;
+		len++;
+	}
+	do {
+		out.push_back(static_cast<char>(tmp[len]));
+	} while (len--);
+}
+
 /**
  * Convert a container of bytes into a uint64_t
  *
@@ -113,10 +136,9 @@ uint64_t toUint64(T container)
 {
 	auto size = container.size();
 	assert(size < 9); // Max size for uint64_t
-	uint64_t num = container[0];
-	num <<= ((size - 1) * 8);
-	for (size_t i = 1; i < size; i++) {
-		num |= (container[i] << ((size - 1 - i) * 8));
+	uint64_t num = 0;
+	for (size_t i = 0; i < size; i++) {
+		num = (num << 8) | static_cast<uint64_t>(container[i]);
 	}
 	return num;
 }